@@ -0,0 +1,160 @@
+/** @file
+ A standalone benchmark of the AttributeKernel cull functions.
+
+ Times the scalar, SSE2 and AVX versions of the distance cull over 1,000,
+ 10,000 and 100,000 emitters scattered around a level, with the listener
+ moving a little on each pass as it does from tick to tick, and logs the
+ time per emitter of each and how much faster it is than the scalar one. The
+ vectorised versions must give the same results as the scalar one, they're
+ checked against it on every size. Versions which weren't compiled or which
+ this CPU can't run are skipped.
+
+ It isn't part of the app project. Build it as a console application with this
+ file and fmod_app/AttributeKernel.cpp as its sources, linked against the same
+ JUCE library and with the same FMOD headers as the app (or FMOD_MOCK defined
+ to 1), and optimised, as the numbers of a debug build don't mean much.
+
+ Options (all optional):
+ - @c -updates @e n				emitter updates timed for each version and size, 50000000
+ - @c -seed @e n				seed for the emitters, 1
+ */
+
+#include "../fmod_app/headers.h"
+#include "../fmod_app/AttributeKernel.h"
+
+namespace
+{
+	const int sizes[] = { 1000, 10000, 100000 };
+
+	struct Version
+	{
+		const char* name;
+		AttributeKernel::CullFunction function;
+	};
+
+	/** The versions this build has and this CPU can run, the scalar one first. */
+	int getVersions(Version* versions)
+	{
+		const AttributeKernel::CullFunction fastest = AttributeKernel::getCullFunction();
+		int numVersions = 0;
+
+		versions[numVersions].name = "scalar";
+		versions[numVersions++].function = AttributeKernel::cullScalar;
+
+		// getCullFunction() only chooses a vectorised version the CPU can run
+	#if ATTRIBUTEKERNEL_SSE2
+		if(fastest != AttributeKernel::cullScalar)
+		{
+			versions[numVersions].name = "SSE2";
+			versions[numVersions++].function = AttributeKernel::cullSSE2;
+		}
+	#endif
+
+	#if ATTRIBUTEKERNEL_AVX
+		if(fastest == AttributeKernel::cullAVX)
+		{
+			versions[numVersions].name = "AVX";
+			versions[numVersions++].function = AttributeKernel::cullAVX;
+		}
+	#endif
+
+		return numVersions;
+	}
+
+	/** Times every version over one number of emitters and logs the results.
+	 @return false if a version's results differ from the scalar one's. */
+	bool run(Random& random, Version const* versions, int numVersions, int numEmitters, int64 numUpdates)
+	{
+		HeapBlock<Vector3> positions(numEmitters);
+		HeapBlock<float> maxDistances(numEmitters);
+
+		// a level a couple of hundred metres across, about a third of it within earshot
+		for(int i = 0; i < numEmitters; i++)
+		{
+			positions[i].x = random.nextFloat() * 200.0f - 100.0f;
+			positions[i].y = random.nextFloat() * 10.0f;
+			positions[i].z = random.nextFloat() * 200.0f - 100.0f;
+			maxDistances[i] = 20.0f + random.nextFloat() * 80.0f;
+		}
+
+		HeapBlock<float> distances(numEmitters), expectedDistances(numEmitters);
+		HeapBlock<uint8> inRange(numEmitters), expectedInRange(numEmitters);
+
+		const int numPasses = (int)jmax((int64)1, numUpdates / numEmitters);
+		bool ok = true;
+		double scalarTime = 0;
+
+		for(int v = 0; v < numVersions; v++)
+		{
+			Vector3 listener;
+			listener.x = 0;
+			listener.y = 1.8f;
+			listener.z = 0;
+
+			int64 numInRange = 0;
+			const int64 start = Time::getHighResolutionTicks();
+
+			for(int pass = 0; pass < numPasses; pass++)
+			{
+				// walks up to 10 metres and back to the start, so it never leaves the level
+				listener.x = (float)(pass % 1000) * 0.01f;
+				numInRange += versions[v].function(positions, maxDistances, numEmitters, listener, distances, inRange);
+			}
+
+			const double time = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start)
+								* 1.0e9 / ((double)numPasses * numEmitters);
+
+			// the last pass of each version has the same listener position
+			if(v == 0)
+			{
+				scalarTime = time;
+				memcpy(expectedDistances, distances, numEmitters * sizeof(float));
+				memcpy(expectedInRange, inRange, (size_t)numEmitters);
+			}
+			else if(memcmp(distances, expectedDistances, numEmitters * sizeof(float)) != 0
+					|| memcmp(inRange, expectedInRange, (size_t)numEmitters) != 0)
+			{
+				Logger::outputDebugString("FAILED: the " + String(versions[v].name) + " results differ from the scalar ones with "
+										  + String(numEmitters) + " emitters");
+				ok = false;
+			}
+
+			Logger::outputDebugString(String(numEmitters).paddedLeft(' ', 6) + " emitters, "
+									  + String(versions[v].name).paddedRight(' ', 6) + ": "
+									  + String(time, 3) + " ns per emitter, "
+									  + String(scalarTime / time, 2) + "x scalar, "
+									  + String((double)numInRange / numPasses, 0) + " in range");
+		}
+
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	initialiseJuce_NonGUI();
+
+	int64 seed = 1, numUpdates = 50000000;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		const String arg(argv[i]), value(argv[i + 1]);
+
+		if(arg == "-updates")		numUpdates = jmax((int64)1, value.getLargeIntValue());
+		else if(arg == "-seed")		seed = value.getLargeIntValue();
+	}
+
+	Version versions[3];
+	const int numVersions = getVersions(versions);
+
+	Logger::outputDebugString(String("getCullFunction() chooses ") + AttributeKernel::getCullFunctionName());
+
+	Random random(seed);
+	bool ok = true;
+
+	for(int i = 0; i < numElementsInArray(sizes); i++)
+		ok = run(random, versions, numVersions, sizes[i], numUpdates) && ok;
+
+	shutdownJuce_NonGUI();
+	return ok ? 0 : 1;
+}
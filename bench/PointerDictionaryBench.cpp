@@ -0,0 +1,144 @@
+/** @file
+ A standalone benchmark of PointerDictionary lookups.
+
+ Fills a dictionary with 10, 100, 1,000 and 10,000 object names like the
+ game's (e.g., "brick-2147" or "barrel.pos") and times looking up names picked
+ at random from it, by String and by String with a hash computed beforehand
+ (as callers which look up the same key repeatedly can). The time per lookup
+ should stay flat as the number of keys grows.
+ For comparison it also times StringArray::indexOf(), the linear search the
+ dictionary used to do, which grows with the number of keys.
+
+ It isn't part of the app project. Build it as a console application with this
+ file as the only source, linked against the same JUCE library as the app, and
+ optimised, as the numbers of a debug build don't mean much.
+
+ Options (all optional):
+ - @c -lookups @e n				lookups timed at each size, 1000000
+ - @c -seed @e n				seed for the names and the order they're looked up in, 1
+ */
+
+#include <juce/juce.h>
+#include "../fmod_app/PointerDictionary.h"
+
+namespace
+{
+	const int sizes[] = { 10, 100, 1000, 10000 };
+
+	/** A name like the game's, unique to i. */
+	String makeName(Random& random, int i)
+	{
+		static const char* const kinds[] = { "soldier", "bullet", "brick", "barrel", "tyre", "grenade" };
+		static const char* const suffixes[] = { "", ".pos", ".vel", ".dir" };
+
+		return String(kinds[random.nextInt(numElementsInArray(kinds))]) + "-" + String(i)
+			   + suffixes[random.nextInt(numElementsInArray(suffixes))];
+	}
+
+	double nanosecondsSince(int64 start, int numLookups)
+	{
+		return Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start) * 1.0e9 / numLookups;
+	}
+
+	/** Times one size of dictionary and logs the results.
+	 @return false if a lookup found the wrong object. */
+	bool run(Random& random, int numKeys, int numLookups)
+	{
+		StringArray names;
+		HeapBlock<int> objects(numKeys);
+		PointerDictionary<int> dictionary;
+
+		for(int i = 0; i < numKeys; i++)
+		{
+			names.add(makeName(random, i));
+			objects[i] = i;
+			dictionary.add(names.getReference(i), &objects[i]);
+		}
+
+		// the order of the lookups, chosen up front so it isn't timed
+		HeapBlock<int> order(numLookups);
+
+		for(int i = 0; i < numLookups; i++)
+			order[i] = random.nextInt(numKeys);
+
+		HeapBlock<uint32> hashes(numKeys);
+
+		for(int i = 0; i < numKeys; i++)
+			hashes[i] = PointerDictionary<int>::hashName(names.getReference(i));
+
+		bool ok = true;
+		int64 sum = 0;
+
+		int64 start = Time::getHighResolutionTicks();
+
+		for(int i = 0; i < numLookups; i++)
+		{
+			int* object = dictionary.get(names.getReference(order[i]));
+			ok = ok && object == &objects[order[i]];
+			sum += *object;
+		}
+
+		const double byString = nanosecondsSince(start, numLookups);
+
+		start = Time::getHighResolutionTicks();
+
+		for(int i = 0; i < numLookups; i++)
+		{
+			const int key = order[i];
+			int* object = dictionary.get(names.getReference(key), hashes[key]);
+			ok = ok && object == &objects[key];
+			sum += *object;
+		}
+
+		const double byHash = nanosecondsSince(start, numLookups);
+
+		// far fewer of these, each one reads on average half the keys
+		const int numSearches = jmax(1, jmin(numLookups, numLookups * 100 / numKeys));
+		start = Time::getHighResolutionTicks();
+
+		for(int i = 0; i < numSearches; i++)
+		{
+			const int index = names.indexOf(names.getReference(order[i]));
+			ok = ok && index == order[i];
+			sum += index;
+		}
+
+		const double linear = nanosecondsSince(start, numSearches);
+
+		Logger::outputDebugString(String(numKeys).paddedLeft(' ', 6) + " keys: "
+								  + String(byString, 1) + " ns by String, "
+								  + String(byHash, 1) + " ns by hash, "
+								  + String(linear, 1) + " ns by StringArray::indexOf()"
+								  + (sum == 0 ? " " : ""));		// so the lookups can't be optimised away
+
+		if(!ok)
+			Logger::outputDebugString("FAILED: a lookup of " + String(numKeys) + " keys found the wrong object");
+
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	initialiseJuce_NonGUI();
+
+	int64 seed = 1;
+	int numLookups = 1000000;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		const String arg(argv[i]), value(argv[i + 1]);
+
+		if(arg == "-lookups")		numLookups = jmax(1, value.getIntValue());
+		else if(arg == "-seed")		seed = value.getLargeIntValue();
+	}
+
+	Random random(seed);
+	bool ok = true;
+
+	for(int i = 0; i < numElementsInArray(sizes); i++)
+		ok = run(random, sizes[i], numLookups) && ok;
+
+	shutdownJuce_NonGUI();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include "headers.h"
+#include "AttributeKernel.h"
+
+#include <cmath>
+
+#ifdef _MSC_VER
+ #include <intrin.h>
+#elif ATTRIBUTEKERNEL_AVX
+ #include <cpuid.h>
+#endif
+
+#if ATTRIBUTEKERNEL_SSE2
+ #include <emmintrin.h>
+#endif
+
+#if ATTRIBUTEKERNEL_AVX
+ #include <immintrin.h>
+ #ifdef _MSC_VER
+  #define AVX_FUNCTION
+ #else
+  #define AVX_FUNCTION __attribute__((target("avx")))
+ #endif
+#endif
+
+namespace AttributeKernel
+{
+	int cullScalar(const Vector3* positions, const float* maxDistances, int numEmitters,
+				   Vector3 const& listener, float* distances, uint8* inRange)
+	{
+		int numInRange = 0;
+		
+		for(int i = 0; i < numEmitters; i++)
+		{
+			const float dx = positions[i].x - listener.x;
+			const float dy = positions[i].y - listener.y;
+			const float dz = positions[i].z - listener.z;
+			const float distanceSquared = (dx * dx + dy * dy) + dz * dz;
+			const bool isInRange = distanceSquared <= maxDistances[i] * maxDistances[i];
+			
+			distances[i] = sqrtf(distanceSquared);
+			inRange[i] = isInRange ? 1 : 0;
+			numInRange += inRange[i];
+		}
+		
+		return numInRange;
+	}
+	
+	/* For expanding a 4 bit comparison mask into 4 bytes of inRange, in memory order. */
+	static const uint8 maskBytes[16][4] =
+	{
+		{ 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 1, 1, 0, 0 },
+		{ 0, 0, 1, 0 }, { 1, 0, 1, 0 }, { 0, 1, 1, 0 }, { 1, 1, 1, 0 },
+		{ 0, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 1, 1, 0, 1 },
+		{ 0, 0, 1, 1 }, { 1, 0, 1, 1 }, { 0, 1, 1, 1 }, { 1, 1, 1, 1 }
+	};
+	
+	static const uint8 maskCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	
+	/* The vectorised versions load four Vector3s (twelve floats) as three
+	 registers, which interleave the emitters' coordinates as
+	 
+		x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+	 
+	 and the listener position is repeated in the same pattern. The squared
+	 differences are then shuffled so that each lane holds one emitter. */
+	
+#if ATTRIBUTEKERNEL_SSE2
+	int cullSSE2(const Vector3* positions, const float* maxDistances, int numEmitters,
+				 Vector3 const& listener, float* distances, uint8* inRange)
+	{
+		const __m128 listener0 = _mm_setr_ps(listener.x, listener.y, listener.z, listener.x);
+		const __m128 listener1 = _mm_setr_ps(listener.y, listener.z, listener.x, listener.y);
+		const __m128 listener2 = _mm_setr_ps(listener.z, listener.x, listener.y, listener.z);
+		
+		int numInRange = 0;
+		int i = 0;
+		
+		for(; i + 4 <= numEmitters; i += 4)
+		{
+			const float* p = &positions[i].x;
+			__m128 d0 = _mm_sub_ps(_mm_loadu_ps(p), listener0);
+			__m128 d1 = _mm_sub_ps(_mm_loadu_ps(p + 4), listener1);
+			__m128 d2 = _mm_sub_ps(_mm_loadu_ps(p + 8), listener2);
+			d0 = _mm_mul_ps(d0, d0);
+			d1 = _mm_mul_ps(d1, d1);
+			d2 = _mm_mul_ps(d2, d2);
+			
+			const __m128 x2y2x3y3 = _mm_shuffle_ps(d1, d2, _MM_SHUFFLE(2, 1, 3, 2));
+			const __m128 x0x1y1z1 = _mm_shuffle_ps(d0, d1, _MM_SHUFFLE(1, 0, 3, 0));
+			const __m128 y0z0y1z1 = _mm_shuffle_ps(d0, x0x1y1z1, _MM_SHUFFLE(3, 2, 2, 1));
+			const __m128 xs = _mm_shuffle_ps(x0x1y1z1, x2y2x3y3, _MM_SHUFFLE(2, 0, 1, 0));
+			const __m128 ys = _mm_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+			const __m128 zs = _mm_shuffle_ps(y0z0y1z1, d2, _MM_SHUFFLE(3, 0, 3, 1));
+			
+			const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(xs, ys), zs);
+			const __m128 maxDistance = _mm_loadu_ps(maxDistances + i);
+			const int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(maxDistance, maxDistance)));
+			
+			_mm_storeu_ps(distances + i, _mm_sqrt_ps(distanceSquared));
+			
+			memcpy(inRange + i, maskBytes[mask], 4);
+			numInRange += maskCounts[mask];
+		}
+		
+		return numInRange + cullScalar(positions + i, maxDistances + i, numEmitters - i,
+									   listener, distances + i, inRange + i);
+	}
+#endif
+	
+#if ATTRIBUTEKERNEL_AVX
+	// AVX shuffles work within each 128-bit half, so the low half takes
+	// emitters i to i+3 and the high half i+4 to i+7 in the SSE2 layout
+	static inline AVX_FUNCTION __m256 loadHalves(const float* low, const float* high)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+	}
+	
+	AVX_FUNCTION int cullAVX(const Vector3* positions, const float* maxDistances, int numEmitters,
+							 Vector3 const& listener, float* distances, uint8* inRange)
+	{
+		const __m256 listener0 = _mm256_setr_ps(listener.x, listener.y, listener.z, listener.x,
+												listener.x, listener.y, listener.z, listener.x);
+		const __m256 listener1 = _mm256_setr_ps(listener.y, listener.z, listener.x, listener.y,
+												listener.y, listener.z, listener.x, listener.y);
+		const __m256 listener2 = _mm256_setr_ps(listener.z, listener.x, listener.y, listener.z,
+												listener.z, listener.x, listener.y, listener.z);
+		
+		int numInRange = 0;
+		int i = 0;
+		
+		for(; i + 8 <= numEmitters; i += 8)
+		{
+			const float* p = &positions[i].x;
+			__m256 d0 = _mm256_sub_ps(loadHalves(p, p + 12), listener0);
+			__m256 d1 = _mm256_sub_ps(loadHalves(p + 4, p + 16), listener1);
+			__m256 d2 = _mm256_sub_ps(loadHalves(p + 8, p + 20), listener2);
+			d0 = _mm256_mul_ps(d0, d0);
+			d1 = _mm256_mul_ps(d1, d1);
+			d2 = _mm256_mul_ps(d2, d2);
+			
+			const __m256 x2y2x3y3 = _mm256_shuffle_ps(d1, d2, _MM_SHUFFLE(2, 1, 3, 2));
+			const __m256 x0x1y1z1 = _mm256_shuffle_ps(d0, d1, _MM_SHUFFLE(1, 0, 3, 0));
+			const __m256 y0z0y1z1 = _mm256_shuffle_ps(d0, x0x1y1z1, _MM_SHUFFLE(3, 2, 2, 1));
+			const __m256 xs = _mm256_shuffle_ps(x0x1y1z1, x2y2x3y3, _MM_SHUFFLE(2, 0, 1, 0));
+			const __m256 ys = _mm256_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+			const __m256 zs = _mm256_shuffle_ps(y0z0y1z1, d2, _MM_SHUFFLE(3, 0, 3, 1));
+			
+			const __m256 distanceSquared = _mm256_add_ps(_mm256_add_ps(xs, ys), zs);
+			const __m256 maxDistance = _mm256_loadu_ps(maxDistances + i);
+			const int mask = _mm256_movemask_ps(_mm256_cmp_ps(distanceSquared, _mm256_mul_ps(maxDistance, maxDistance), _CMP_LE_OQ));
+			
+			_mm256_storeu_ps(distances + i, _mm256_sqrt_ps(distanceSquared));
+			
+			memcpy(inRange + i, maskBytes[mask & 15], 4);
+			memcpy(inRange + i + 4, maskBytes[mask >> 4], 4);
+			numInRange += maskCounts[mask & 15] + maskCounts[mask >> 4];
+		}
+		
+		_mm256_zeroupper();
+		
+		return numInRange + cullScalar(positions + i, maxDistances + i, numEmitters - i,
+									   listener, distances + i, inRange + i);
+	}
+	
+	static bool cpuSupportsAVX()
+	{
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const unsigned int ecx = (unsigned int)info[2];
+	#else
+		unsigned int eax, ebx, ecx, edx;
+		
+		if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+	#endif
+		
+		const bool hasAVX = (ecx & (1 << 28)) != 0;
+		const bool hasOSXSAVE = (ecx & (1 << 27)) != 0;	// the OS saves the AVX registers
+		
+		if(!(hasAVX && hasOSXSAVE))
+			return false;
+		
+	#ifdef _MSC_VER
+		const unsigned int xcr0 = (unsigned int)_xgetbv(0);
+	#else
+		// xgetbv, spelt out as older assemblers don't know it
+		unsigned int xcr0, xcr0High;
+		__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+	#endif
+		
+		return (xcr0 & 6) == 6;		// and the OS has turned on saving them
+	}
+#endif
+	
+#if ATTRIBUTEKERNEL_SSE2
+	static bool cpuSupportsSSE2()
+	{
+		// every x64 CPU has it, and outside MSVC the SSE2 version is only compiled when the compiler
+		// already uses SSE2 throughout (as it does on every Intel Mac, i386 included)
+	#if defined(_M_X64) || defined(__x86_64__) || !defined(_MSC_VER)
+		return true;
+	#else
+		int info[4];
+		__cpuid(info, 1);
+		return (info[3] & (1 << 26)) != 0;
+	#endif
+	}
+#endif
+	
+	static CullFunction chooseCullFunction(const char*& name)
+	{
+	#if ATTRIBUTEKERNEL_AVX
+		if(cpuSupportsAVX())
+		{
+			name = "AVX";
+			return cullAVX;
+		}
+	#endif
+		
+	#if ATTRIBUTEKERNEL_SSE2
+		if(cpuSupportsSSE2())
+		{
+			name = "SSE2";
+			return cullSSE2;
+		}
+	#endif
+		
+		name = "scalar";
+		return cullScalar;
+	}
+	
+	static const char* cullFunctionName = 0;
+	static CullFunction cullFunction = 0;
+	
+	CullFunction getCullFunction()
+	{
+		if(cullFunction == 0)
+		{
+			// every thread would choose the same function, so a race here is harmless
+			const char* name;
+			CullFunction function = chooseCullFunction(name);
+			cullFunctionName = name;
+			cullFunction = function;
+		}
+		
+		return cullFunction;
+	}
+	
+	const char* getCullFunctionName()
+	{
+		getCullFunction();
+		return cullFunctionName;
+	}
+}
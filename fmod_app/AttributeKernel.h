@@ -0,0 +1,65 @@
+#ifndef ATTRIBUTEKERNEL_H
+#define ATTRIBUTEKERNEL_H
+
+/** Distance culling of every emitter against the listener in one pass.
+
+ ObjectStore runs this over all of its slots once per tick to find which of
+ the moved objects are close enough to the listener to be worth updating.
+ Vectorised versions are compiled where the compiler supports them and the
+ fastest one the CPU can run is picked the first time getCullFunction() is
+ called. All the versions give the same results.
+ */
+namespace AttributeKernel
+{
+	/** Computes each emitter's distance from the listener and whether it's within its range.
+
+	 @param positions		The emitters' positions.
+	 @param maxDistances	The distance beyond which each emitter can't be heard.
+	 @param numEmitters		The length of all the arrays.
+	 @param listener		The listener's position.
+	 @param distances		Receives each emitter's distance from the listener.
+	 @param inRange			Receives 1 for each emitter within its maxDistance, 0 otherwise.
+	 @return				The number of emitters in range. */
+	typedef int (*CullFunction)(const Vector3* positions,
+								const float* maxDistances,
+								int numEmitters,
+								Vector3 const& listener,
+								float* distances,
+								uint8* inRange);
+
+	int cullScalar(const Vector3* positions, const float* maxDistances, int numEmitters,
+				   Vector3 const& listener, float* distances, uint8* inRange);
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#define ATTRIBUTEKERNEL_SSE2 1
+	int cullSSE2(const Vector3* positions, const float* maxDistances, int numEmitters,
+				 Vector3 const& listener, float* distances, uint8* inRange);
+#endif
+
+	// the AVX version is compiled with __attribute__((target("avx"))) outside MSVC, which the intrinsics
+	// headers only honour from GCC 4.9 and clang 3.8 (Xcode 8's Apple clang 8); older compilers don't get it
+#if defined(__clang__) && defined(__apple_build_version__)
+	#define ATTRIBUTEKERNEL_TARGET_ATTRIBUTE (__clang_major__ >= 8)
+#elif defined(__clang__)
+	#define ATTRIBUTEKERNEL_TARGET_ATTRIBUTE ((__clang_major__ * 100 + __clang_minor__) >= 308)
+#elif defined(__GNUC__)
+	#define ATTRIBUTEKERNEL_TARGET_ATTRIBUTE ((__GNUC__ * 100 + __GNUC_MINOR__) >= 409)
+#else
+	#define ATTRIBUTEKERNEL_TARGET_ATTRIBUTE 0
+#endif
+
+#if (defined(_MSC_VER) && _MSC_FULL_VER >= 160040219 && (defined(_M_IX86) || defined(_M_X64))) \
+	|| (ATTRIBUTEKERNEL_TARGET_ATTRIBUTE && (defined(__i386__) || defined(__x86_64__)))
+	#define ATTRIBUTEKERNEL_AVX 1
+	int cullAVX(const Vector3* positions, const float* maxDistances, int numEmitters,
+				Vector3 const& listener, float* distances, uint8* inRange);
+#endif
+
+	/** Returns the fastest version this machine can run. */
+	CullFunction getCullFunction();
+
+	/** Returns the name of the version returned by getCullFunction(), for logging. */
+	const char* getCullFunctionName();
+}
+
+#endif // ATTRIBUTEKERNEL_H
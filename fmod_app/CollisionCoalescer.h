@@ -0,0 +1,117 @@
+#ifndef COLLISIONCOALESCER_H
+#define COLLISIONCOALESCER_H
+
+#include <juce/juce.h>
+
+/** Thins out bursts of collisions between the same object and surface.
+
+ When a grenade scatters debris, each piece may report many collisions within
+ a few milliseconds as it bounces and settles, and each would otherwise start
+ an event. Once a hit of an object on a surface has played, further hits of
+ the same pair are dropped for a short refractory window unless they're
+ harder than the hardest one played in it, in which case they play and the
+ window starts again from them. So the first hit of a burst is heard without
+ delay, the loudest impact of the burst is never lost and the rattle of
+ smaller hits after it costs nothing.
+
+ Objects are identified by a small non-negative int such as an ObjectKeyTable
+ handle and surfaces by a small int, or -1 for any other surface.
+ */
+class CollisionCoalescer
+{
+public:
+	enum { maxSurfaces = 8 };
+
+	/** @param windowMs	The refractory window in milliseconds. */
+	CollisionCoalescer(double windowMs = 80.0)
+	:	window(windowMs),
+		numPlayed(0),
+		numCoalesced(0)
+	{
+	}
+
+	/** Sets the refractory window in milliseconds, 0 lets every hit through. */
+	void setWindow(double windowMs)
+	{
+		window = windowMs;
+	}
+
+	/** Returns whether a hit should play, and if so remembers it as the hardest of its window.
+	 @param object		The object which was hit.
+	 @param surface		What it hit, from 0 to maxSurfaces - 1, or -1 for anything else.
+	 @param velocity	How hard it was hit. */
+	bool shouldPlay(int object, int surface, float velocity)
+	{
+		jassert(object >= 0 && surface >= -1 && surface < (int)maxSurfaces);
+
+		const double now = Time::getMillisecondCounterHiRes();
+		const int index = object * (maxSurfaces + 1) + surface + 1;
+
+		while(hits.size() <= index)
+		{
+			Hit none;
+			none.time = 0;
+			none.velocity = -1.0f;		// nothing played yet
+			hits.add(none);
+		}
+
+		Hit& hit = hits.getReference(index);
+
+		if(hit.velocity >= 0 && now - hit.time < window && velocity <= hit.velocity)
+		{
+			numCoalesced++;
+			return false;
+		}
+
+		hit.time = now;
+		hit.velocity = velocity;
+		numPlayed++;
+		return true;
+	}
+
+	/** Forgets an object's hits, call when it's destroyed so its number can be reused. */
+	void forget(int object)
+	{
+		const int start = object * (maxSurfaces + 1);
+
+		for(int i = start; i < jmin(start + (int)maxSurfaces + 1, hits.size()); i++)
+			hits.getReference(i).velocity = -1.0f;
+	}
+
+	/** Forgets the hits of every object, but not the counts. */
+	void forgetAll()
+	{
+		hits.clearQuick();
+	}
+
+	int getNumPlayed() const { return numPlayed; }
+	int getNumCoalesced() const { return numCoalesced; }
+
+	void logStats() const
+	{
+		Logger::outputDebugString("Collisions: " + String(numPlayed) + " played, " + String(numCoalesced) + " coalesced");
+	}
+
+	/** Forgets all the hits and the counts. */
+	void clear()
+	{
+		forgetAll();
+		numPlayed = numCoalesced = 0;
+	}
+
+private:
+	struct Hit
+	{
+		double time;		// when the hardest hit of the window played, in milliseconds
+		float velocity;		// -1 if none has
+	};
+
+	double window;
+	Array<Hit> hits;		// indexed by object and surface
+	int numPlayed, numCoalesced;
+
+	CollisionCoalescer(const CollisionCoalescer&);
+	CollisionCoalescer& operator=(const CollisionCoalescer&);
+};
+
+#endif // COLLISIONCOALESCER_H
@@ -1,11 +1,24 @@
 #include "headers.h"
 #include "ConnectionServer.h"
+#include "GameconBinary.h"
 
-ConnectionServer::ConnectionServer (int port)
+ConnectionServer::ConnectionServer (int port, int maxClientsToAllow, int datagramPort)
 :	Thread("ConnectionServer"),
-	connection(0)
+	datagramSocket(0),
+	maxClients(maxClientsToAllow),
+	capture(0),
+	replayAtRecordedSpeed(false)
 {
 	listener.createListener(port);
+	poller.add(listener.getRawSocketHandle(), &listener);
+	
+	if(datagramPort > 0)
+	{
+		datagramSocket = new DatagramSocket(datagramPort);
+		datagramBuffer.malloc(GameconBinary::maxDatagramSize);
+		poller.add(datagramSocket->getRawSocketHandle(), datagramSocket);
+	}
+	
 	startThread();
 }
 
@@ -13,106 +26,449 @@ ConnectionServer::~ConnectionServer ()
 {
 	stopThread(4000);
 	listener.close();
+	
+	if(datagramSocket)
+		poller.remove(datagramSocket->getRawSocketHandle());
+	
+	deleteAndZero(datagramSocket);
+	stopCapture();
 }
 
-void ConnectionServer::run()
+bool ConnectionServer::startCapture(File const& file)
 {
-	const int bufferSize = 32768;
-	char buffer[bufferSize];
+	TrafficCapture::Writer* writer = new TrafficCapture::Writer(file);
 	
-	int lastTime = 0;
-	int tickRate = 15;
+	if(!writer->openedOk())
+	{
+		delete writer;
+		return false;
+	}
+	
+	const ScopedLock sl(requestLock);
+	delete capture;
+	capture = writer;
+	return true;
+}
+
+void ConnectionServer::stopCapture()
+{
+	const ScopedLock sl(requestLock);
+	deleteAndZero(capture);
+}
+
+void ConnectionServer::startReplay(File const& file, bool atRecordedSpeed)
+{
+	const ScopedLock sl(requestLock);
+	replayFile = file;
+	replayAtRecordedSpeed = atRecordedSpeed;
+	replayRequested = 1;
+}
+
+void ConnectionServer::run()
+{
+	// how long to block waiting for data before checking whether the thread should exit
+	const int waitTimeout = 100;
+	const int maxReady = 64;
+	void* ready[maxReady];
 	
 	while(threadShouldExit() == false)
 	{
-		int time = Time::getMillisecondCounter();
+		// checked without the lock on every pass, the file and speed are read under it
+		if(replayRequested.exchange(0) != 0)
+		{
+			const ScopedLock sl(requestLock);
+			const File file(replayFile);
+			const bool atRecordedSpeed = replayAtRecordedSpeed;
+			
+			const ScopedUnlock su(requestLock);
+			replay(file, atRecordedSpeed);
+		}
 		
-		if(connection)
+		const int numReady = poller.wait(waitTimeout, ready, maxReady);
+		
+		for(int i = 0; i < numReady; i++)
 		{
-			if(connection->isConnected())
-			{
-				int ready = connection->waitUntilReady (true, tickRate);
-				
-				if(ready < 0)
-				{
-					disconnect();
-				}
-				else if(ready > 0)
-				{					
-					int numBytes = connection->read(buffer, bufferSize, false);
-					
-					if(numBytes > 0)
-					{										
-						StringArray array;
-						String msg(buffer, numBytes);
-						array.addLines(msg);
-						
-						int num = array.size();					
-						for(int i = 0; i < num; i++)
-						{
-							const String& line = array[i];
-							StringArray data;
-							data.addTokens(line, true);
-							
-							handleConnectionMessage(data[0], data[1], data[2]);
-						}
-					}
-					else if(numBytes < 0)
-					{
-						disconnect();
-					}
-				}
-				else
-				{					
-					Thread::sleep(tickRate);
-				}
-			}
+#if GAMECON_LATENCY
+			receiveTime = LatencyProbe::now();
+#endif
+			if(ready[i] == &listener)
+				acceptClient();
+			else if(ready[i] == datagramSocket)
+				readDatagram();
 			else
-			{
-				disconnect();
-			}
+				readClient((Client*)ready[i]);
 		}
-		else
+	}
+	
+	// can't call virtual handleConnectionClosed() perhaps this thread 'joins' another on exit..?
+	for(int i = 0; i < clients.size(); i++)
+	{
+		if(clients.getUnchecked(i)->socket)
+			poller.remove(clients.getUnchecked(i)->socket->getRawSocketHandle());
+	}
+	
+	clients.clear();
+}
+
+void ConnectionServer::acceptClient()
+{
+	StreamingSocket* socket = listener.waitForNextConnection();
+	
+	if(socket == 0)
+		return;
+	
+	char buf[1024];
+	snprintf(buf, 1024, "%s %s:%d",
+			 clients.size() < maxClients ? "Connected to" : "Too many clients, refused",
+			 (const char*)socket->getHostName().toUTF8(), 
+			 socket->getPort());
+	Logger::outputDebugString(buf);
+	
+	if(clients.size() >= maxClients)
+	{
+		delete socket;
+		return;
+	}
+	
+	Client* client = new Client(getFreeClientId(), socket);
+	clients.add(client);
+	poller.add(socket->getRawSocketHandle(), client);
+	
+	captureRecord(TrafficCapture::clientOpened, client->id, 0, 0);
+	handleConnectionOpened(client->id);
+}
+
+void ConnectionServer::readClient(Client* client)
+{
+	if(!client->socket->isConnected())
+	{
+		disconnect(client);
+		return;
+	}
+	
+	if(client->parser.isFull())
+	{
+		Logger::outputDebugString("ConnectionServer: discarding an over-long message");
+		client->parser.skipLine();
+	}
+	
+	int bufferSize;
+	char* buffer = client->parser.getWriteBuffer(bufferSize);
+	int numBytes = client->socket->read(buffer, bufferSize, false);
+	
+	if(numBytes > 0)
+	{
+		captureRecord(TrafficCapture::clientData, client->id, buffer, numBytes);
+		client->parser.written(numBytes);
+		processIncoming(client);
+	}
+	else if(numBytes < 0)
+	{
+		disconnect(client);
+	}
+}
+
+void ConnectionServer::readDatagram()
+{
+	const int numBytes = datagramSocket->read(datagramBuffer, GameconBinary::maxDatagramSize, false);
+	
+	if(numBytes <= 0)
+		return;
+	
+	captureRecord(TrafficCapture::datagram, 0, datagramBuffer, numBytes);
+	processDatagram(datagramBuffer, numBytes);
+}
+
+void ConnectionServer::processDatagram(const uint8* data, int numBytes)
+{
+	if(numBytes <= 0 || data[0] != GameconBinary::datagramMarker)
+		return;
+	
+	GameconBinary::Reader reader(data + 1, numBytes - 1);
+	const uint32 senderId = reader.readVarint();
+	const uint32 sequence = reader.readVarint();
+	
+	if(reader.failed())
+		return;
+	
+	++numDatagrams;
+	
+	if(!isNewDatagram(senderId, sequence))
+	{
+		++numStaleDatagrams;
+		return;
+	}
+	
+	const int size = reader.getNumBytesRemaining();
+	handleConnectionDatagram((const uint8*)reader.readBytes(size), size);
+}
+
+bool ConnectionServer::isNewDatagram(uint32 senderId, uint32 sequence)
+{
+	// a sender this far behind its last datagram is assumed to have restarted
+	const int restartDistance = 1024;
+	const int maxSenders = 256;
+	
+	for(int i = 0; i < datagramSenders.size(); i++)
+	{
+		DatagramSender& sender = datagramSenders.getReference(i);
+		
+		if(sender.id == senderId)
+		{
+			// compared as a signed difference so the sequence can wrap around
+			const int age = (int)(sender.lastSequence - sequence);
+			
+			if(age >= 0 && age < restartDistance)
+				return false;
+			
+			sender.lastSequence = sequence;
+			return true;
+		}
+	}
+	
+	if(datagramSenders.size() >= maxSenders)
+		datagramSenders.remove(0);
+	
+	DatagramSender sender;
+	sender.id = senderId;
+	sender.lastSequence = sequence;
+	datagramSenders.add(sender);
+	return true;
+}
+
+void ConnectionServer::disconnect(Client* client)
+{
+	const int clientId = client->id;
+	
+	if(client->socket)
+	{
+		char buf[1024];
+		snprintf(buf, 1024, "Disconnected from %s:%d",
+			   (const char*)client->socket->getHostName().toUTF8(), 
+			   client->socket->getPort());
+		Logger::outputDebugString(buf);
+		
+		poller.remove(client->socket->getRawSocketHandle());
+		captureRecord(TrafficCapture::clientClosed, clientId, 0, 0);
+	}
+	
+	clients.removeObject(client);
+	
+	handleConnectionClosed(clientId);
+}
+
+int ConnectionServer::getFreeClientId() const
+{
+	for(int clientId = 1; ; clientId++)
+	{
+		bool inUse = false;
+		
+		for(int i = 0; i < clients.size() && !inUse; i++)
+			inUse = clients.getUnchecked(i)->id == clientId;
+		
+		if(!inUse)
+			return clientId;
+	}
+}
+
+void ConnectionServer::receiveData(Client* client, const char* data, int size)
+{
+	// the same steps as readClient(), with the bytes copied in rather than read
+	while(size > 0)
+	{
+		if(client->parser.isFull())
 		{
-			if (listener.waitUntilReady(true, 200))
-			{
-				connection = listener.waitForNextConnection();
+			Logger::outputDebugString("ConnectionServer: discarding an over-long message");
+			client->parser.skipLine();
+		}
+		
+		int bufferSize;
+		char* buffer = client->parser.getWriteBuffer(bufferSize);
+		const int numBytes = jmin(size, bufferSize);
+		
+		memcpy(buffer, data, numBytes);
+		client->parser.written(numBytes);
+		processIncoming(client);
+		
+		data += numBytes;
+		size -= numBytes;
+	}
+}
+
+void ConnectionServer::captureRecord(TrafficCapture::RecordType type, int clientId, const void* data, int size)
+{
+	const ScopedLock sl(requestLock);
+	
+	if(capture)
+		capture->write(type, clientId, data, size);
+}
+
+void ConnectionServer::replay(File const& file, bool atRecordedSpeed)
+{
+	TrafficCapture::Reader reader(file);
+	
+	if(!reader.isValid())
+	{
+		Logger::outputDebugString("ConnectionServer: can't replay " + file.getFullPathName());
+		return;
+	}
+	
+	Logger::outputDebugString("ConnectionServer: replaying " + file.getFullPathName());
+	
+	// the recorded sequence numbers start again from wherever the senders were
+	datagramSenders.clear();
+	
+	Array<Client*> replayClients;	// indexed by the recorded client ID
+	TrafficCapture::Record record;
+	int numRecords = 0;
+	const int64 startTime = Time::getHighResolutionTicks();
+	
+	while(!threadShouldExit() && reader.next(record))
+	{
+		if(atRecordedSpeed)
+		{
+			const int64 due = startTime + Time::secondsToHighResolutionTicks(record.time / 1000000.0);
+			const int64 ticksPerMs = jmax((int64)1, Time::secondsToHighResolutionTicks(0.001));
+			const int64 remaining = due - Time::getHighResolutionTicks();
+			
+			if(remaining > ticksPerMs)
+				wait((int)(remaining / ticksPerMs));
+		}
+		
+#if GAMECON_LATENCY
+		receiveTime = LatencyProbe::now();
+#endif
+		
+		Client* client = replayClients[record.clientId];
+		numRecords++;
+		
+		switch(record.type)
+		{
+			case TrafficCapture::clientOpened:
+				if(client == 0 && clients.size() < maxClients)
+				{
+					client = new Client(getFreeClientId(), 0);
+					clients.add(client);
+					
+					while(replayClients.size() <= record.clientId)
+						replayClients.add(0);
+					
+					replayClients.set(record.clientId, client);
+					handleConnectionOpened(client->id);
+				}
+				break;
 				
-				if(connection)
+			case TrafficCapture::clientClosed:
+				if(client)
 				{
-                    char buf[1024];
-					snprintf(buf, 1024, "Connected to %s:%d",
-						   (const char*)connection->getHostName().toUTF8(), 
-						   connection->getPort());
-                    Logger::outputDebugString(buf);
-					handleConnect();
+					replayClients.set(record.clientId, 0);
+					disconnect(client);
 				}
-			}
+				break;
+				
+			case TrafficCapture::clientData:
+				if(client)
+					receiveData(client, (const char*)record.data, record.size);
+				break;
+				
+			case TrafficCapture::datagram:
+				processDatagram(record.data, record.size);
+				break;
+				
+			default:
+				break;
 		}
+	}
+	
+	// close the clients which were still connected when the capture stopped
+	for(int i = 0; i < replayClients.size(); i++)
+	{
+		if(replayClients.getUnchecked(i))
+			disconnect(replayClients.getUnchecked(i));
+	}
+	
+	const double seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime);
+	
+	Logger::outputDebugString("ConnectionServer: replayed " + String(numRecords) + " records, "
+							  + String(reader.getSize()) + " bytes in " + String(seconds, 3) + "s ("
+							  + String(reader.getSize() / (jmax(seconds, 0.000001) * 1048576.0), 1) + " MB/s)");
+}
+
+void ConnectionServer::processIncoming(Client* client)
+{
+	// stops at the first incomplete line or frame, the rest is kept for the next read
+	while(client->binaryMode ? processFrame(client) : processLine(client))
+	{
+	}
+}
+
+bool ConnectionServer::processLine(Client* client)
+{
+	TokenSpan line;
+	
+	if(!client->parser.readLine(line))
+		return false;
+	
+	if(line.equals(GameconBinary::switchMessage))
+	{
+		// acknowledge, everything after this line is sent as binary frames
+		String ack(String(GameconBinary::switchMessage) + "\n");
+		if(client->socket)
+			client->socket->write(ack.toUTF8(), ack.length());
+		client->binaryMode = true;
+	}
+	else if(!line.isEmpty())
+	{
+		TokenSpan tokens[3];
+		MessageParser::tokenise(line, tokens, 3);
 		
-		if(threadShouldExit())
-			break;
-		
-		if((time-lastTime) >= tickRate)
-		{
-			tick();
-			lastTime = time;	
-		}	
+		if(tokens[0].equals(GameconBinary::pingName))
+			replyToPing(client, tokens[2]);
+		else
+			handleConnectionMessage(client->id, tokens[0], tokens[1], tokens[2]);
 	}
 	
-	deleteAndZero(connection);	// can't call virtual handleDisconnect() perhaps this thread 'joins' another on exit..?
+	return true;
 }
 
-void ConnectionServer::disconnect()
+void ConnectionServer::replyToPing(Client* client, TokenSpan const& content)
 {
-    char buf[1024];
-	snprintf(buf, 1024, "Disconnected from %s:%d",
-		   (const char*)connection->getHostName().toUTF8(), 
-		   connection->getPort());
-    Logger::outputDebugString(buf);
+	if(client->socket == 0)
+		return;
 	
-	deleteAndZero(connection);
+	// echo the client's token with the datagram counts so it can work out how many were lost
+	char reply[256];
+	const int length = snprintf(reply, sizeof(reply), "%s s \"%.*s %d %d\"\n",
+								GameconBinary::pingName,
+								jmin(content.length, 128), content.text,
+								numDatagrams.get(), numStaleDatagrams.get());
 	
-	handleDisconnect();
+	client->socket->write(reply, jmin(length, (int)sizeof(reply) - 1));
 }
 
+bool ConnectionServer::processFrame(Client* client)
+{
+	MessageParser& parser = client->parser;
+	const char* header = parser.peek(GameconBinary::headerSize);
+	
+	if(header == 0)
+		return false;
+	
+	if((uint8)header[0] != GameconBinary::frameMarker)
+	{
+		parser.consume(1); // lost sync, skip until the next marker
+		return true;
+	}
+	
+	const int bodySize = (uint8)header[1];
+	const char* frame = parser.peek(GameconBinary::headerSize + bodySize);
+	
+	if(frame == 0)
+		return false;
+	
+	if(bodySize > 0)
+		handleConnectionFrame(client->id, (const uint8*)frame + GameconBinary::headerSize, bodySize);
+	
+	parser.consume(GameconBinary::headerSize + bodySize);
+	return true;
+}
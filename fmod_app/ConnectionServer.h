@@ -2,43 +2,179 @@
 #define CONNECTIONSERVER_H
 
 #include <juce/juce.h>
+#include "MessageParser.h"
+#include "SocketPoller.h"
+#include "LatencyProbe.h"
+#include "TrafficCapture.h"
 
 
 /** A class which handles low level communication of the network.
- This has a very simple protocol which can be adapted flexibly. */
+ This has a very simple protocol which can be adapted flexibly.
+ 
+ Several clients (e.g., the game, bots and replay feeds) may be connected at
+ once. One network thread waits on all of their sockets and the listener with
+ a SocketPoller, and each client has its own parse state. Clients are given
+ the lowest free ID from 1 up to the maximum number of clients, so IDs are
+ reused once a client has gone.
+ 
+ Vectors may also be sent as UDP datagrams (if a datagram port is given) so
+ that a lost packet doesn't hold up later, more useful, updates behind it.
+ Each datagram carries a sender ID and a sequence number and any datagram
+ older than the newest seen from its sender is discarded; the rest are passed
+ to handleConnectionDatagram().
+ 
+ Connections start out sending ASCII lines. A client may switch its connection
+ to the compact binary framing by sending GameconBinary::switchMessage, after
+ which every complete frame is passed to handleConnectionFrame(). An ASCII
+ GameconBinary::pingName line is answered straight away by the network thread
+ rather than passed on (e.g., for the load generator to measure the lag).
+ 
+ Everything read from the sockets can be captured to a file (see
+ TrafficCapture) and later replayed through the same parsing, so a recorded
+ session can be reproduced exactly, e.g., to measure the parsing and dispatch.
+ 
+ Data is read straight into a MessageParser and handed on as spans of its
+ buffer, so no memory is allocated per message. Lines and frames which are
+ split across reads are joined before they are passed on.
+ 
+ The network thread only reads and parses; it doesn't tick the sound engine
+ (see GameEngineServer, which does that on its own audio thread). */
 class ConnectionServer : public Thread
 {		
 public:
 	/** Constructor for the ConnectionServer.
 	 This also starts the network thread.
-	 @param port The TCP/IP port on which to communicate */
-	ConnectionServer (int port = 60000);
+	 @param port		The TCP/IP port on which to communicate
+	 @param maxClients	The most clients which can be connected at once, any more are turned away.
+	 @param datagramPort	The UDP port on which to receive vector datagrams, or 0 for none. */
+	ConnectionServer (int port = 60000, int maxClients = 64, int datagramPort = 0);
 	virtual ~ConnectionServer ();
-		
+	
 	/** The main messages from the connection.
-	 This is called on the internal thread.
+	 This is called on the internal thread. The spans are only valid during the call.
+	 @param clientId	The client which sent the message.
 	 @param name		An arbitrary name and/or command for the payload.
 	 @param type		A code to signify the format of the value payload parameter.
 	 @param message		The value payload for the message. */
-	virtual void handleConnectionMessage(String const& name, String const& type, String const& message) = 0;
+	virtual void handleConnectionMessage(int clientId, TokenSpan const& name, TokenSpan const& type, TokenSpan const& message) = 0;
+	
+	/** A binary frame from the connection.
+	 This is called on the internal thread.
+	 @param clientId	The client which sent the frame.
+	 @param body		The frame body (starting with the type byte), without the header.
+	 @param size		The number of bytes in the body. */
+	virtual void handleConnectionFrame(int clientId, const uint8* body, int size) = 0;
 	
-	/** A message to indicate the connection was made. 
+	/** The records of a UDP datagram which is newer than any before it from the same sender.
+	 This is called on the internal thread.
+	 @param body		The records, after the datagram's marker, sender ID and sequence number.
+	 @param size		The number of bytes of records. */
+	virtual void handleConnectionDatagram(const uint8* body, int size) = 0;
+	
+	/** A message to indicate a client connected. 
 	 This is called on the internal thread. */
-	virtual void handleConnect() = 0;
+	virtual void handleConnectionOpened(int clientId) = 0;
 	
-	/** A message to indicate the connection was terminated. 
+	/** A message to indicate a client's connection was terminated. 
 	 This is called on the internal thread.*/
-	virtual void handleDisconnect() = 0;
+	virtual void handleConnectionClosed(int clientId) = 0;
+	
+	/** The most clients which can be connected at once, and the largest client ID. */
+	int getMaxClients() const { return maxClients; }
+	
+	/** The number of vector datagrams received, including stale ones. */
+	int getNumDatagrams() const { return numDatagrams.get(); }
+	
+	/** The number of datagrams discarded because a newer one had already arrived from the same sender. */
+	int getNumStaleDatagrams() const { return numStaleDatagrams.get(); }
 	
-	/** A message called regularly on the network thread. */
-	virtual void tick() = 0;
+	/** Starts appending everything read from the sockets to a capture file.
+	 @return false if the file couldn't be opened. */
+	bool startCapture(File const& file);
+	
+	/** Stops capturing and closes the capture file. */
+	void stopCapture();
+	
+	/** Asks the network thread to replay a capture file.
+	 The recorded clients connect, send and disconnect again exactly as they did
+	 in the capture, using the same parsing as live connections. Live sockets
+	 aren't served until the replay has finished, which is logged with its
+	 throughput.
+	 @param file				A file written by startCapture().
+	 @param atRecordedSpeed		True to keep the recorded timing, false to replay as fast as possible. */
+	void startReplay(File const& file, bool atRecordedSpeed);
+	
+#if GAMECON_LATENCY
+protected:
+	/** When the read (or accept) which is being handled returned, for LatencyProbe. */
+	int64 getReceiveTime() const { return receiveTime; }
+#endif
 	
 private:
+	/** The connection and parse state of one client. */
+	struct Client
+	{
+		Client(int clientId, StreamingSocket* clientSocket)
+		:	id(clientId),
+			socket(clientSocket),
+			binaryMode(false)
+		{
+		}
+		
+		~Client()
+		{
+			delete socket;
+		}
+		
+		int id;
+		StreamingSocket* socket;
+		bool binaryMode;
+		MessageParser parser;
+	};
+	
+	/** The newest sequence number received from a datagram sender. */
+	struct DatagramSender
+	{
+		uint32 id;
+		uint32 lastSequence;
+	};
+	
 	StreamingSocket listener;
-	StreamingSocket *connection;
+	DatagramSocket* datagramSocket;		// 0 if datagrams aren't being received
+	HeapBlock<uint8> datagramBuffer;
+	Array<DatagramSender> datagramSenders;
+	Atomic<int> numDatagrams, numStaleDatagrams;
+	SocketPoller poller;
+	OwnedArray<Client> clients;		// a replayed client has no socket
+	const int maxClients;
+	
+	CriticalSection requestLock;		// guards capture and the replay request
+	TrafficCapture::Writer* capture;
+	File replayFile;
+	bool replayAtRecordedSpeed;
+	Atomic<int> replayRequested;		// set last by startReplay(), so run() can test it without the lock
+#if GAMECON_LATENCY
+	int64 receiveTime;
+#endif
 	
 	void run();	
-	void disconnect();
+	void acceptClient();
+	void readClient(Client* client);
+	void readDatagram();
+	void processDatagram(const uint8* data, int size);
+	void receiveData(Client* client, const char* data, int size);
+	void captureRecord(TrafficCapture::RecordType type, int clientId, const void* data, int size);
+	void replay(File const& file, bool atRecordedSpeed);
+	bool isNewDatagram(uint32 senderId, uint32 sequence);
+	void disconnect(Client* client);
+	int getFreeClientId() const;
+	void processIncoming(Client* client);
+	bool processLine(Client* client);
+	void replyToPing(Client* client, TokenSpan const& content);
+	bool processFrame(Client* client);
+	
+	ConnectionServer(const ConnectionServer&);
+	ConnectionServer& operator=(const ConnectionServer&);
 };
 
 #endif // CONNECTIONSERVER_H
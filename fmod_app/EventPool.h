@@ -0,0 +1,242 @@
+#ifndef EVENTPOOL_H
+#define EVENTPOOL_H
+
+#include "PointerDictionary.h"
+
+/** A pool of instances of one FMOD event.
+
+ Instances are created ahead of time by prewarm() so that acquire() is a pop
+ from a free list rather than an FMOD lookup by name (and the event's data is
+ already loaded when it's first played). Each pooled Event's user data points
+ back to its pool, so when ObjectStore finds that an Event has finished it
+ can hand it back with release() without a search.
+
+ If all the instances are playing, acquire() falls back to asking FMOD for
+ another one, which is counted as a miss and then kept in the pool too. The
+ pool therefore grows to the number of instances that actually play at once
+ (limited by the event's max playbacks setting in FMOD Designer).
+ */
+class EventPool
+{
+public:
+	EventPool(EventSystem* system, String const& eventPath)
+	:	eventsystem(system),
+		path(eventPath),
+		numHits(0),
+		numMisses(0)
+	{
+	}
+
+	~EventPool()
+	{
+		// the events outlive the pool inside FMOD so they mustn't point back to it
+		for(int i = 0; i < instances.size(); i++)
+			instances[i]->event->setUserData(0);
+	}
+
+	/** Creates instances until there are numInstances in the pool.
+	 FMOD hands back an instance which isn't playing, so each one is held
+	 (started paused and silent) while the next is asked for and they're all
+	 stopped again at the end. Stops early if the event doesn't exist or FMOD
+	 starts handing back instances that are already pooled, e.g., once the
+	 event's max playbacks are reached. */
+	void prewarm(int numInstances)
+	{
+		Array<Event*> held;
+		Array<float> volumes;
+
+		while(instances.size() < numInstances)
+		{
+			Event* event = 0;
+
+			if(eventsystem->getEvent(path.toUTF8(), FMOD_EVENT_DEFAULT, &event) != FMOD_OK
+			   || event == 0 || getInstance(event) != 0)
+				break;
+
+			freeInstances.add(adopt(event));
+
+			float volume = 1.0f;
+			ERRCHECK(event->getVolume(&volume));
+			ERRCHECK(event->setVolume(0));
+			ERRCHECK(event->setPaused(true));
+			ERRCHECK(event->start());
+
+			held.add(event);
+			volumes.add(volume);
+		}
+
+		for(int i = 0; i < held.size(); i++)
+		{
+			Event* event = held.getUnchecked(i);
+
+			ERRCHECK(event->stop(true));
+			ERRCHECK(event->setPaused(false));
+			ERRCHECK(event->setVolume(volumes.getUnchecked(i)));
+		}
+	}
+
+	/** Returns an instance to play, or 0 if FMOD has none to give (e.g., the event doesn't exist). */
+	Event* acquire()
+	{
+		if(freeInstances.size() > 0)
+		{
+			numHits++;
+
+			Instance* instance = freeInstances.getLast();
+			freeInstances.removeLast();
+			instance->inUse = true;
+			return instance->event;
+		}
+
+		numMisses++;
+
+		Event* event = 0;
+
+		if(eventsystem->getEvent(path.toUTF8(), FMOD_EVENT_DEFAULT, &event) != FMOD_OK || event == 0)
+			return 0;
+
+		// FMOD may return a pooled instance it has stolen, which is already in use
+		if(getInstance(event) == 0)
+			adopt(event)->inUse = true;
+
+		return event;
+	}
+
+	/** Returns an Event to its pool once it has stopped.
+	 Events which didn't come from a pool, or have already been released, are ignored. */
+	static void release(Event* event)
+	{
+		Instance* instance = getInstance(event);
+
+		if(instance != 0 && instance->inUse)
+		{
+			instance->inUse = false;
+			instance->pool->freeInstances.add(instance);
+		}
+	}
+
+	String const& getPath() const { return path; }
+	int getNumInstances() const { return instances.size(); }
+	int getNumHits() const { return numHits; }
+	int getNumMisses() const { return numMisses; }
+
+private:
+	struct Instance
+	{
+		Instance(Event* instanceEvent, EventPool* owner)
+		:	event(instanceEvent),
+			pool(owner),
+			inUse(false)
+		{
+		}
+
+		Event* event;
+		EventPool* pool;
+		bool inUse;
+	};
+
+	EventSystem* eventsystem;
+	String path;
+	OwnedArray<Instance> instances;
+	Array<Instance*> freeInstances;
+	int numHits, numMisses;
+
+	Instance* adopt(Event* event)
+	{
+		Instance* instance = new Instance(event, this);
+		instances.add(instance);
+		ERRCHECK(event->setUserData(instance));
+		return instance;
+	}
+
+	static Instance* getInstance(Event* event)
+	{
+		void* userData = 0;
+
+		if(event->getUserData(&userData) != FMOD_OK)
+			return 0;
+
+		return (Instance*)userData;
+	}
+
+	EventPool(const EventPool&);
+	EventPool& operator=(const EventPool&);
+};
+
+/** The EventPools for all the events played on the hot path, looked up by event path.
+ A pool is created the first time an unknown path is asked for. */
+class EventPools
+{
+public:
+	EventPools()
+	:	eventsystem(0)
+	{
+	}
+
+	/** Must be called before prewarm() or getEvent(). */
+	void setEventSystem(EventSystem* system)
+	{
+		eventsystem = system;
+	}
+
+	/** Creates numInstances instances of an event ahead of time. */
+	void prewarm(String const& path, int numInstances)
+	{
+		getPool(path)->prewarm(numInstances);
+	}
+
+	/** Returns an instance of an event from its pool.
+	 The Event is returned to the pool by EventPool::release() when it has stopped. */
+	Event* getEvent(String const& path)
+	{
+		return getPool(path)->acquire();
+	}
+
+	/** Returns the pool for an event path, creating it if needed. */
+	EventPool* getPool(String const& path)
+	{
+		const uint32 hash = PointerDictionary<EventPool>::hashName(path);
+		EventPool* pool = dictionary.get(path, hash);
+
+		if(pool == 0)
+		{
+			pool = new EventPool(eventsystem, path);
+			pools.add(pool);
+			dictionary.add(path, hash, pool);
+		}
+
+		return pool;
+	}
+
+	/** Writes the hits and misses of each pool to the debug log. */
+	void logStats() const
+	{
+		int totalHits = 0, totalMisses = 0;
+
+		for(int i = 0; i < pools.size(); i++)
+		{
+			const EventPool* pool = pools[i];
+			totalHits += pool->getNumHits();
+			totalMisses += pool->getNumMisses();
+
+			Logger::outputDebugString(pool->getPath() + ": " + String(pool->getNumInstances()) + " instances, "
+									  + String(pool->getNumHits()) + " hits, " + String(pool->getNumMisses()) + " misses");
+		}
+
+		Logger::outputDebugString("Event pools: " + String(totalHits) + " hits, " + String(totalMisses) + " misses");
+	}
+
+	/** Deletes the pools, call before the EventSystem is released. */
+	void clear()
+	{
+		dictionary.clear();
+		pools.clear();
+	}
+
+private:
+	EventSystem* eventsystem;
+	PointerDictionary<EventPool> dictionary;
+	OwnedArray<EventPool> pools;
+};
+
+#endif // EVENTPOOL_H
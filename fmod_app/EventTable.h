@@ -0,0 +1,95 @@
+#ifndef EVENTTABLE_H
+#define EVENTTABLE_H
+
+#include "EventPool.h"
+
+/** The one-shot events indexed by (category, key) pairs, e.g., (footsteps, wood).
+
+ Each category is an event location (such as "shooter/footsteps/") and a list
+ of key names which are appended to it. The event paths are built and resolved
+ to their EventPools once, when the FEV is loaded, so playing a sound is then
+ an array index with no string building or lookup by name. Categories and
+ keys are plain ints so they can be given by enums. The names sent by the
+ game (e.g., the surface of a footstep) are turned into keys by findKey(),
+ one hash lookup rather than a comparison with each key name.
+
+ Events which aren't in the FEV file resolve to nothing and getEvent()
+ returns 0 for them.
+ */
+class EventTable
+{
+public:
+	enum { maxCategories = 8, maxKeys = 8 };
+
+	EventTable()
+	{
+		for(int key = 0; key < maxKeys; key++)
+			keyNumbers[key] = key;
+
+		clear();
+	}
+
+	/** Resolves the events of a category and prewarms their pools.
+	 @param category		The index of the category, less than maxCategories.
+	 @param location		The path prefix of the category's events.
+	 @param names			The key names, indexed by key, at most maxKeys of them.
+	 @param numNames		The number of key names.
+	 @param pools			Where the EventPools are kept.
+	 @param numInstances	The number of instances to prewarm for each event. */
+	void addCategory(int category, String const& location, const char* const* names, int numNames,
+					 EventPools& pools, int numInstances)
+	{
+		jassert(isPositiveAndBelow(category, (int)maxCategories) && numNames <= maxKeys);
+
+		keys[category].clear();
+
+		for(int key = 0; key < numNames; key++)
+		{
+			keys[category].add(names[key], &keyNumbers[key]);
+
+			EventPool* pool = pools.getPool(location + names[key]);
+			pool->prewarm(numInstances);
+
+			// no instances means the event isn't in the FEV
+			table[category][key] = pool->getNumInstances() > 0 ? pool : 0;
+		}
+	}
+
+	/** Returns the key for a name sent by the game, or -1 if the category has no such key. */
+	int findKey(int category, String const& name) const
+	{
+		const int* key = keys[category].get(name);
+		return key != 0 ? *key : -1;
+	}
+
+	/** Returns an instance of an event from its pool, or 0 if the event wasn't found in the FEV. */
+	Event* getEvent(int category, int key) const
+	{
+		if(!isPositiveAndBelow(key, (int)maxKeys) || table[category][key] == 0)
+			return 0;
+
+		return table[category][key]->acquire();
+	}
+
+	/** Forgets the resolved events, call before the EventPools are cleared. */
+	void clear()
+	{
+		for(int category = 0; category < maxCategories; category++)
+		{
+			keys[category].clear();
+
+			for(int key = 0; key < maxKeys; key++)
+				table[category][key] = 0;
+		}
+	}
+
+private:
+	EventPool* table[maxCategories][maxKeys];
+	PointerDictionary<const int> keys[maxCategories];	// the key for each name, pointing into keyNumbers
+	int keyNumbers[maxKeys];
+
+	EventTable(const EventTable&);
+	EventTable& operator=(const EventTable&);
+};
+
+#endif // EVENTTABLE_H
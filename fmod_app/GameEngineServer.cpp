@@ -1,5 +1,6 @@
 #include "headers.h"
 #include "GameEngineServer.h"
+#include "GameconBinary.h"
 
 
 Collision::Collision(String const& name, float vel)
@@ -9,15 +10,31 @@ Collision::Collision(String const& name, float vel)
 }
 
 
-GameEngineServer::GameEngineServer(int port)
-:	ConnectionServer(port)
+GameEngineServer::GameEngineServer(int port, int maxClients, int datagramPort)
+:	ConnectionServer(port, maxClients, datagramPort),
+	messageNamesFull(false),
+	textTooLong(false),
+	commands(commandQueueSize),
+	audioThread(*this),
+	tickScheduler(1000.0 / 15.0)
 {
-	//startThread();
+	for(int i = 0; i < maxClients; i++)
+		binaryNames.add(new Array<BinaryName>());
 }
 
 GameEngineServer::~GameEngineServer()
 {
-	//stopThread(4000);
+	stopAudioThread();
+}
+
+void GameEngineServer::startAudioThread()
+{
+	audioThread.startThread(7);
+}
+
+void GameEngineServer::stopAudioThread()
+{
+	audioThread.stopThread(4000);
 }
 
 String GameEngineServer::getGameInstanceString(String const& name, int gameObjectInstanceID)
@@ -32,7 +49,7 @@ String GameEngineServer::getGameInstanceString(String const& name, int gameObjec
 	}
 }
 
-void GameEngineServer::handleConnectionMessage(String const& name, String const& t, String const& message)
+void GameEngineServer::handleConnectionMessage(int /*clientId*/, TokenSpan const& name, TokenSpan const& t, TokenSpan const& message)
 {
 	static const juce_wchar typeBool			= 'b';
 	static const juce_wchar typeInt				= 'i';
@@ -41,14 +58,12 @@ void GameEngineServer::handleConnectionMessage(String const& name, String const&
 	static const juce_wchar typeVector			= 'v';
 	static const juce_wchar typeCollision		= 'c';
 	
-	static const String actionCreate		= "create";
-	static const String actionDestroy		= "destroy";
-	static const String actionHit			= "hit";
-	
 	juce_wchar type = t[0];
 	
-	StringArray messageItems;
-	messageItems.addTokens(message.unquoted(), true);
+	// the most any message has is an id plus a three element vector
+	const int maxItems = 4;
+	TokenSpan messageItems[maxItems];
+	MessageParser::tokenise(message.unquoted(), messageItems, maxItems);
 	
 	int messageIndex = 0;
 	int gameObjectInstanceID = 0;
@@ -59,86 +74,541 @@ void GameEngineServer::handleConnectionMessage(String const& name, String const&
 		type = CharacterFunctions::toLowerCase(type);
 	}
 	
-	String object;
-	String param;
-	
-	if(name.containsChar('.'))
+	// names are only interned for the types handled here, anything else goes to handleOther()
+	if(type != typeBool && type != typeInt && type != typeReal
+	   && type != typeString && type != typeVector && type != typeCollision)
 	{
-		object = name.upToLastOccurrenceOf(".", false, false);
-		param = name.fromLastOccurrenceOf(".", false, false);
-	}
-	else
-	{
-		object = param = name;
+		handleOther(name.toString(), t.toString(), message.toString());
+		return;
 	}
 	
+	Command command;
+	command.name = getMessageName(name);
+	command.gameObjectInstanceID = gameObjectInstanceID;
+	command.text[0] = 0;
+	
+	if(command.name == 0)
+		return;
+	
 	switch (type) 
 	{
 		case typeBool: {
-			bool flag = messageItems[messageIndex].getIntValue() != 0;
-			
-			handleBool(object, gameObjectInstanceID, param, flag);
+			command.type = Command::BoolMessage;
+			command.flag = messageItems[messageIndex].getIntValue() != 0;
+			post(command);
 			return;
 		} break;
 			
 		case typeInt: {
-			int data = messageItems[messageIndex].getIntValue();
-			
-			if(param == actionCreate)
-			{
-				gameObjectInstanceID = data;
-				handleCreate(object, gameObjectInstanceID);
-				return;
-			}
-			else if(param == actionDestroy)
-			{
-				gameObjectInstanceID = data;
-				handleDestroy(object, gameObjectInstanceID);
-				return;
-			}
-			else
-			{
-				handleInt(object, gameObjectInstanceID, param, data);
-				return;
-			}
-			
+			command.type = Command::IntMessage;
+			command.intValue = messageItems[messageIndex].getIntValue();
+			post(command);
+			return;
 		} break;
 			
 		case typeReal: {
-			double data = messageItems[messageIndex].getDoubleValue(); 
-			handleReal(object, gameObjectInstanceID, param, data);
+			command.type = Command::RealMessage;
+			command.realValue = messageItems[messageIndex].getDoubleValue(); 
+			post(command);
 			return;
 		} break;
 			
 		case typeString: {
-			const String& data = messageItems[messageIndex];
-			handleString(object, gameObjectInstanceID, param, data);
+			command.type = Command::StringMessage;
+			if(setText(command, messageItems[messageIndex].text, messageItems[messageIndex].length)) post(command);
 			return;
 		} break;
 			
 		case typeVector: {
+			command.type = Command::VectorMessage;
+			command.vector[0] = messageItems[messageIndex++].getFloatValue();
+			command.vector[1] = messageItems[messageIndex++].getFloatValue();
+			command.vector[2] = messageItems[messageIndex++].getFloatValue();
+			post(command);
+			return;
+		} break;
+			
+		case typeCollision: {
+			command.type = Command::HitMessage;
+			const TokenSpan& otherName = messageItems[messageIndex++];
+			command.velocity = messageItems[messageIndex++].getFloatValue();
+			if(setText(command, otherName.text, otherName.length)) post(command);
+			return;
+		}
+	}
+}
+
+void GameEngineServer::handleConnectionFrame(int clientId, const uint8* body, int size)
+{
+	Array<BinaryName>& names = *binaryNames.getUnchecked(clientId - 1);
+	GameconBinary::Reader reader(body, size);
+	const uint8 type = reader.readByte();
+	const int nameIndex = (int)reader.readVarint();
+	
+	if(type == GameconBinary::typeName)
+	{
+		int length = reader.getNumBytesRemaining();
+		declareBinaryName(names, nameIndex, TokenSpan(reader.readBytes(length), length));
+		return;
+	}
+	
+	if(!isPositiveAndBelow(nameIndex, names.size()) || names.getReference(nameIndex).text.isEmpty())
+	{
+		Logger::outputDebugString("GameEngineServer: binary frame with an undeclared name");
+		return;
+	}
+	
+	BinaryName& declared = names.getReference(nameIndex);
+	
+	Command command;
+	command.gameObjectInstanceID = reader.readSignedVarint();
+	command.text[0] = 0;
+	
+	if(!(type == 'b' || type == 'i' || type == 'r' || type == 's' || type == 'v' || type == 'c'))
+	{
+		handleOther(declared.text, String::charToString((juce_wchar)type), String::empty);
+		return;
+	}
+	
+	// interned the first time the name is used for a message, so declared names which are only ever other names aren't
+	if(declared.name == 0)
+	{
+		const char* text = (const char*)declared.text.toUTF8();
+		declared.name = getMessageName(TokenSpan(text, (int)strlen(text)));
+	}
+	
+	command.name = declared.name;
+	
+	if(command.name == 0)
+		return;
+	
+	switch(type)
+	{
+		case 'b': {
+			command.type = Command::BoolMessage;
+			command.flag = reader.readByte() != 0;
+			if(reader.failed()) break;
+			post(command);
+		} break;
+			
+		case 'i': {
+			command.type = Command::IntMessage;
+			command.intValue = reader.readSignedVarint();
+			if(reader.failed()) break;
+			post(command);
+		} break;
+			
+		case 'r': {
+			command.type = Command::RealMessage;
+			command.realValue = reader.readDouble();
+			if(reader.failed()) break;
+			post(command);
+		} break;
+			
+		case 's': {
+			int length = (int)reader.readVarint();
+			const char* data = reader.readBytes(length);
+			if(reader.failed()) break;
+			command.type = Command::StringMessage;
+			if(setText(command, data, length)) post(command);
+		} break;
+			
+		case 'v': {
+			command.type = Command::VectorMessage;
+			command.vector[0] = reader.readFloat();
+			command.vector[1] = reader.readFloat();
+			command.vector[2] = reader.readFloat();
+			if(reader.failed()) break;
+			post(command);
+		} break;
+			
+		case 'c': {
+			command.type = Command::HitMessage;
+			const int otherIndex = (int)reader.readVarint();
+			command.velocity = reader.readFloat();
+			if(reader.failed() || !isPositiveAndBelow(otherIndex, names.size())) break;
+			const char* otherName = (const char*)names.getReference(otherIndex).text.toUTF8();
+			if(*otherName != 0 && setText(command, otherName, (int)strlen(otherName))) post(command);
+		} break;
+	}
+}
+
+void GameEngineServer::handleConnectionDatagram(const uint8* body, int size)
+{
+	GameconBinary::Reader reader(body, size);
+	
+	while(reader.getNumBytesRemaining() > 0)
+	{
+		const int length = (int)reader.readVarint();
+		const char* name = reader.readBytes(length);
+		
+		Command command;
+		command.type = Command::VectorMessage;
+		command.gameObjectInstanceID = reader.readSignedVarint();
+		command.vector[0] = reader.readFloat();
+		command.vector[1] = reader.readFloat();
+		command.vector[2] = reader.readFloat();
+		
+		if(reader.failed())
+			break;
+		
+		command.name = getMessageName(TokenSpan(name, length));
+		
+		if(command.name)
+			post(command);
+	}
+}
+
+void GameEngineServer::handleConnectionOpened(int clientId)
+{
+	Command command;
+	command.type = Command::Connected;
+	command.name = 0;
+	command.gameObjectInstanceID = clientId;
+	post(command);
+	
+	// wake the audio thread if it's waiting for a client
+	++numConnections;
+	audioThread.notify();
+}
+
+void GameEngineServer::handleConnectionClosed(int clientId)
+{
+	// the next client with this ID declares its own names
+	binaryNames.getUnchecked(clientId - 1)->clear();
+	
+	Command command;
+	command.type = Command::Disconnected;
+	command.name = 0;
+	command.gameObjectInstanceID = clientId;
+	post(command);
+	--numConnections;
+}
+
+void GameEngineServer::post(Command const& decoded)
+{
+#if GAMECON_LATENCY
+	Command command(decoded);
+	command.received = getReceiveTime();
+	command.parsed = LatencyProbe::now();
+#else
+	Command const& command = decoded;
+#endif
+	
+	// rather than drop messages wait for the audio thread to catch up, the socket buffers meanwhile
+	while(!commands.push(command))
+	{
+		if(threadShouldExit() || !audioThread.isThreadRunning())
+			return;
+		
+		Thread::sleep(1);
+	}
+	
+	// datagrams can arrive with no client connected, the audio thread only waits while the queue is empty
+	if(numConnections.get() == 0)
+		audioThread.notify();
+}
+
+void GameEngineServer::runAudioThread()
+{
+	const int ticksPerReport = 1000;	// how often to log the jitter
+	
+	while(!audioThread.threadShouldExit())
+	{
+		// there's nothing to tick while no client is connected, so wait for handleConnectionOpened() or post()
+		if(numConnections.get() == 0 && commands.getNumReady() == 0)
+		{
+			audioThread.wait(-1);
+			tickScheduler.restart();
+			continue;
+		}
+		
+		if(!tickScheduler.waitForNextTick(audioThread))
+			break;
+		
+		dispatchCommands();
+		tick();
+		
+#if GAMECON_LATENCY
+		// in the order of Command::Type
+		static const char* const typeNames[] = { "connect", "disconnect", "b", "i", "r", "s", "v", "c" };
+		latency.dumpIfRequested(typeNames, numElementsInArray(typeNames));
+#endif
+		
+		if(tickScheduler.getIntervals().getNumValues() >= ticksPerReport)
+		{
+			Logger::outputDebugString("GameEngineServer: ticks " + tickScheduler.getSummary());
+			tickScheduler.clearStats();
+		}
+	}
+}
+
+void GameEngineServer::dispatchCommands()
+{
+	Command command;
+	
+	while(commands.pop(command))
+	{
+		const MessageName* name = command.name;
+#if GAMECON_LATENCY
+		const int64 dispatched = LatencyProbe::now();
+#endif
+		
+		// create and destroy always go to handleCreate() and handleDestroy()
+		MessageHandler* handler = (name != 0 && name->builtIn == MessageName::notBuiltIn) ? getHandler(name, command.type) : 0;
+		
+		if(handler != 0)
+		{
+			callHandler(handler, command);
+		}
+		else
+		{
+			switch(command.type)
+			{
+				case Command::Connected:
+					handleConnect(command.gameObjectInstanceID);
+					break;
+				
+				case Command::Disconnected:
+					handleDisconnect(command.gameObjectInstanceID);
+					break;
+				
+				case Command::BoolMessage:
+					handleBool(name->object, command.gameObjectInstanceID, name->param, command.flag);
+					break;
+				
+				case Command::IntMessage:
+					handleIntMessage(name, command.gameObjectInstanceID, command.intValue);
+					break;
+				
+				case Command::RealMessage:
+					handleReal(name->object, command.gameObjectInstanceID, name->param, command.realValue);
+					break;
+				
+				case Command::StringMessage:
+					handleString(name->object, command.gameObjectInstanceID, name->param, String(command.text));
+					break;
+				
+				case Command::VectorMessage: {
+					Vector3 vector;
+					float* floatVector = (float*)&vector;
+				
+					// This seemingly pointless complexity is to allow it to work with an
+					// OpenGL Vector3 which contains an array rather than x, y, z members.
+					floatVector[0] = command.vector[0];
+					floatVector[1] = command.vector[1];
+					floatVector[2] = command.vector[2];
+				
+					handleVector(name->object, command.gameObjectInstanceID, name->param, &vector);
+				} break;
+				
+				case Command::HitMessage:
+					handleHit(name->object, command.gameObjectInstanceID, Collision(String(command.text), command.velocity));
+					break;
+			}
+		}
+		
+#if GAMECON_LATENCY
+		latency.record(command.type, command.received, command.parsed, dispatched, LatencyProbe::now());
+#endif
+	}
+}
+
+MessageHandler* GameEngineServer::getHandler(const MessageName* name, int commandType) const
+{
+	// in the order of the value types in Command::Type
+	static const char typeChars[numValueTypes] = { 'b', 'i', 'r', 's', 'v', 'c' };
+	
+	const int typeIndex = commandType - Command::BoolMessage;
+	
+	if(!isPositiveAndBelow(typeIndex, (int)numValueTypes) || handlerTable == 0)
+		return 0;
+	
+	// each name is only looked up in the table the first time it arrives with each type
+	int& handlerNumber = name->handlers[typeIndex];
+	
+	if(handlerNumber == unresolvedAction)
+		handlerNumber = handlerTable->find(typeChars[typeIndex], name->object, name->param);
+	
+	return handlerNumber > 0 ? handlers[handlerNumber - 1] : 0;
+}
+
+void GameEngineServer::callHandler(MessageHandler* handler, Command const& command)
+{
+	const MessageName* name = command.name;
+	
+	switch(command.type)
+	{
+		case Command::BoolMessage:
+			handler->handle(name->object, command.gameObjectInstanceID, &command.flag);
+			break;
+			
+		case Command::IntMessage:
+			handler->handle(name->object, command.gameObjectInstanceID, &command.intValue);
+			break;
+			
+		case Command::RealMessage:
+			handler->handle(name->object, command.gameObjectInstanceID, &command.realValue);
+			break;
+			
+		case Command::StringMessage: {
+			const String value(command.text);
+			handler->handle(name->object, command.gameObjectInstanceID, &value);
+		} break;
+			
+		case Command::VectorMessage: {
 			Vector3 vector;
 			float* floatVector = (float*)&vector;
 			
-			// This seemingly pointless complexity is to allow it to work with an
-			// OpenGL Vector3 which contains an array rather than x, y, z members.
-			floatVector[0] = messageItems[messageIndex++].getFloatValue();
-			floatVector[1] = messageItems[messageIndex++].getFloatValue();
-			floatVector[2] = messageItems[messageIndex++].getFloatValue();
+			floatVector[0] = command.vector[0];
+			floatVector[1] = command.vector[1];
+			floatVector[2] = command.vector[2];
 			
-			handleVector(object, gameObjectInstanceID, param, &vector);
-			return;
+			handler->handle(name->object, command.gameObjectInstanceID, &vector);
 		} break;
 			
-		case typeCollision: {
-			String otherName = messageItems[messageIndex++];
-			float velocity = messageItems[messageIndex++].getFloatValue();
-			handleHit(object, gameObjectInstanceID, Collision(otherName, velocity));
-			return;
+		case Command::HitMessage: {
+			const Collision collision(String(command.text), command.velocity);
+			handler->handle(name->object, command.gameObjectInstanceID, &collision);
+		} break;
+	}
+}
+
+void GameEngineServer::addHandler(char type, const char* object, const char* param, MessageHandler* handler)
+{
+	handlers.add(handler);
+	
+	MessageActionTable::Entry entry;
+	entry.action = handlers.size();
+	entry.type = type;
+	entry.object = 0;
+	entry.param = 0;
+	
+	// the table only points at the names, so keep copies of them
+	const char* names[2] = { object, param };
+	
+	for(int i = 0; i < 2; i++)
+	{
+		if(names[i] == 0)
+			continue;
+		
+		MemoryBlock* copy = new MemoryBlock(names[i], strlen(names[i]) + 1);
+		handlerNames.add(copy);
+		
+		(i == 0 ? entry.object : entry.param) = (const char*)copy->getData();
+	}
+	
+	handlerEntries.add(entry);
+	handlerTable = new MessageActionTable(handlerEntries.getRawDataPointer(), handlerEntries.size());
+}
+
+void GameEngineServer::requestLatencyDump()
+{
+#if GAMECON_LATENCY
+	latency.requestDump();
+#endif
+}
+
+void GameEngineServer::handleIntMessage(const MessageName* name, int gameObjectInstanceID, int data)
+{
+	switch(name->builtIn)
+	{
+		case MessageName::create:
+			handleCreate(name->object, data);
+			break;
+			
+		case MessageName::destroy:
+			handleDestroy(name->object, data);
+			break;
+			
+		default:
+			handleInt(name->object, gameObjectInstanceID, name->param, data);
+			break;
+	}
+}
+
+void GameEngineServer::declareBinaryName(Array<BinaryName>& names, int index, TokenSpan const& name)
+{
+	if(!isPositiveAndBelow(index, (int)maxMessageNames))
+		return;
+	
+	while(names.size() <= index)
+		names.add(BinaryName());
+	
+	BinaryName& declared = names.getReference(index);
+	declared.text = name.toString();
+	declared.name = 0;
+}
+
+const GameEngineServer::MessageName* GameEngineServer::getMessageName(TokenSpan const& name)
+{
+	const uint32 hash = PointerDictionary<MessageName>::hashName(name.text, name.length);
+	MessageName* entry = messageNames.get(name.text, name.length, hash);
+	
+	if(entry == 0)
+	{
+		// names come from a small fixed set in practice, this limit only guards against a misbehaving
+		// client; the audio thread may still be reading older names so once full new names are dropped
+		if(messageNames.size() >= maxMessageNames)
+		{
+			if(!messageNamesFull)
+				Logger::outputDebugString("GameEngineServer: too many message names, messages with new names are dropped from "
+										  + name.toString());
+			
+			messageNamesFull = true;
+			return 0;
 		}
+		
+		// first time this name has been seen, this is the only allocation
+		entry = new MessageName();
+		messageNameStorage.add(entry);
+		
+		entry->name = name.toString();
+		splitName(entry->name, entry->object, entry->param);
+		
+		// create and destroy are recognised once here rather than compared on every int message
+		entry->builtIn = entry->param == "create" ? MessageName::create
+						: entry->param == "destroy" ? MessageName::destroy
+						: MessageName::notBuiltIn;
+		
+		for(int i = 0; i < numValueTypes; i++)
+			entry->handlers[i] = unresolvedAction;
+		messageNames.add(entry->name, hash, entry);
 	}
 	
-	handleOther(name, t, message);
+	return entry;
+}
+
+bool GameEngineServer::setText(Command& command, const char* text, int length)
+{
+	if(length > maxTextLength)
+	{
+		if(!textTooLong)
+			Logger::outputDebugString("GameEngineServer: strings longer than " + String((int)maxTextLength)
+									  + " bytes are dropped, e.g., " + TokenSpan(text, maxTextLength).toString() + "...");
+		
+		textTooLong = true;
+		return false;
+	}
+	
+	if(length > 0)		// a missing value is an empty span whose text is null
+		memcpy(command.text, text, (size_t)length);
+	
+	command.text[length] = 0;
+	return true;
+}
+
+void GameEngineServer::splitName(String const& name, String& object, String& param)
+{
+	if(name.containsChar('.'))
+	{
+		object = name.upToLastOccurrenceOf(".", false, false);
+		param = name.fromLastOccurrenceOf(".", false, false);
+	}
+	else
+	{
+		object = param = name;
+	}
 }
 
 void GameEngineServer::handleCreate(String const& name, int gameObjectInstanceID)
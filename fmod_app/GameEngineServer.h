@@ -3,6 +3,10 @@
 
 #include <juce/juce.h>
 #include "ConnectionServer.h"
+#include "PointerDictionary.h"
+#include "LockFreeQueue.h"
+#include "TickScheduler.h"
+#include "MessageActions.h"
 
 // this is to allow Vector3 to be predefined e.g., to an FMOD_VECTOR to avoid having to have
 // casts in user code and to avoid making this file dependent on <a href=http://www.fmod.org/>FMOD</a> or any other system
@@ -50,19 +54,122 @@ public:
 	float velocity;
 };
 
+/** The message type character for each type of value a handler can be registered for with GameEngineServer::on(). */
+template <class ValueType> struct MessageValueType;
+template <> struct MessageValueType<bool>		{ enum { type = 'b' }; };
+template <> struct MessageValueType<int>		{ enum { type = 'i' }; };
+template <> struct MessageValueType<double>		{ enum { type = 'r' }; };
+template <> struct MessageValueType<String>		{ enum { type = 's' }; };
+template <> struct MessageValueType<Vector3>	{ enum { type = 'v' }; };
+template <> struct MessageValueType<Collision>	{ enum { type = 'c' }; };
+
+/** A function registered with GameEngineServer::on(), see MemberMessageHandler and FunctionMessageHandler. */
+class MessageHandler
+{
+public:
+	virtual ~MessageHandler() {}
+	
+	/** Called on the audio thread.
+	 @param value	Points to the value type the handler was registered for. */
+	virtual void handle(String const& name, int gameObjectInstanceID, const void* value) = 0;
+};
+
+/** Calls a member function for a message. */
+template <class ValueType, class Owner>
+class MemberMessageHandler : public MessageHandler
+{
+public:
+	typedef void (Owner::*Method)(String const& name, int gameObjectInstanceID, ValueType const& value);
+	
+	MemberMessageHandler(Owner* handlerOwner, Method handlerMethod) : owner(handlerOwner), method(handlerMethod) {}
+	
+	void handle(String const& name, int gameObjectInstanceID, const void* value)
+	{
+		(owner->*method)(name, gameObjectInstanceID, *static_cast<const ValueType*>(value));
+	}
+	
+private:
+	Owner* owner;
+	Method method;
+};
+
+/** Calls a free (or static) function for a message. */
+template <class ValueType>
+class FunctionMessageHandler : public MessageHandler
+{
+public:
+	typedef void (*Function)(String const& name, int gameObjectInstanceID, ValueType const& value);
+	
+	FunctionMessageHandler(Function handlerFunction) : function(handlerFunction) {}
+	
+	void handle(String const& name, int gameObjectInstanceID, const void* value)
+	{
+		function(name, gameObjectInstanceID, *static_cast<const ValueType*>(value));
+	}
+	
+private:
+	Function function;
+};
+
 
 /** The GameEngineServer!.
  This does most of the work. Subclass this and implement the virtual functions as required.
- Uncaught messages through not implementing a particular function will be posted to the console. */
+ Uncaught messages through not implementing a particular function will be posted to the console.
+ 
+ Messages are decoded on the network thread and pushed onto a lock-free queue as
+ fixed size commands. A separate audio thread drains the queue once per frame,
+ calling the handle functions, then calls tick(). So a burst of messages doesn't
+ delay the sound engine's update and a slow update doesn't stop the socket being
+ read. Everything apart from handleOther() is called on the audio thread. */
 class GameEngineServer : public ConnectionServer
 {	
 public:
 	/** Constructor for the GameEngineServer.
-	 This also starts the ConnectionServer thread.
-	 @param port The TCP/IP port on which to communicate */
-	GameEngineServer(int port = 60000);	
+	 This also starts the ConnectionServer thread, but not the audio thread as it calls
+	 the subclass, see startAudioThread(). Messages received meanwhile are queued.
+	 @param port		The TCP/IP port on which to communicate
+	 @param maxClients	The most clients which can be connected at once.
+	 @param datagramPort	The UDP port on which to receive vector datagrams, or 0 for none. */
+	GameEngineServer(int port = 60000, int maxClients = 64, int datagramPort = 0);	
 	~GameEngineServer();
 	
+	/** Starts the audio thread which calls the handle functions and tick().
+	 Call this at the end of the subclass's constructor, once it's ready to be called. */
+	void startAudioThread();
+	
+	/** Stops the audio thread, waiting for the current tick to finish.
+	 Call this at the start of the subclass's destructor, before anything the handle
+	 functions or tick() use is destroyed. */
+	void stopAudioThread();
+	
+	/** A message to indicate a client connected.
+	 This is called on the audio thread.
+	 @param clientId	The client's ID, from 1 to ConnectionServer::getMaxClients(). */
+	virtual void handleConnect(int clientId) = 0;
+	
+	/** A message to indicate a client's connection was terminated.
+	 This is called on the audio thread. The ID may be given to a later client.
+	 @param clientId	The client's ID, as passed to handleConnect(). */
+	virtual void handleDisconnect(int clientId) = 0;
+	
+	/** A message called once per frame on the audio thread, after that frame's messages.
+	 It isn't called while no client is connected, the audio thread sleeps until one connects. */
+	virtual void tick() = 0;
+	
+	/** Sets how many times a second tick() is called (about 66.7 by default).
+	 Call this on the audio thread (e.g., from handleConnect()) or before any client connects. */
+	void setTickRate(double ticksPerSecond) { tickScheduler.setRate(ticksPerSecond); }
+	
+	/** Sets what happens to ticks missed when the audio thread falls behind (skip by default). */
+	void setLatePolicy(TickScheduler::LatePolicy policy) { tickScheduler.setLatePolicy(policy); }
+	
+	/** The tick timing histograms, only read these on the audio thread (e.g., from tick()). */
+	TickScheduler const& getTickScheduler() const { return tickScheduler; }
+	
+	/** Logs the latency histograms of each message type at the end of the next tick.
+	 Does nothing unless GAMECON_LATENCY is set, see LatencyProbe. Can be called on any thread. */
+	void requestLatencyDump();
+	
 	/** Simple utility function to concatate a string with an int. 
 	 @param name The string.
 	 @param gameObjectInstanceID The int. If this is zero then only the name will be returned. */
@@ -121,14 +228,149 @@ public:
 	 @param name					The name of the object.
 	 @param gameObjectInstanceID	The unique id of the object (or 0 if no id has been provided). 
 	 @param param					The string parameter's name.
-	 @param content					The string message. */	
+	 @param content					The string message. Strings (and the other names of collisions) longer
+									than 63 bytes are dropped. */	
 	virtual void handleString(String const& name, int gameObjectInstanceID, String const& param, String const& content);
 
-	/** Other messages which haven't been parsed by the GameEngineServer class. */
+	/** Registers a member function to be called for one kind of message instead of the handle function.
+	 e.g.,
+	 @code
+	 on<Vector3>("soldier", "pos", this, &MyServer::soldierMoved);
+	 on<Collision>("bullet", 0, this, &MyServer::bulletHit);
+	 @endcode
+	 Messages with no registered function still go to handleVector(), handleHit() etc.
+	 Register functions before any clients connect (e.g., in the subclass
+	 constructor). Which function (if any) handles a name is worked out the
+	 first time the name arrives, after that calling it costs the same however
+	 many functions are registered.
+	 @param object	The object name, or 0 for any object.
+	 @param param	The parameter name, or 0 for any parameter. As in
+					MessageActionTable the most specific registration wins. */
+	template <class ValueType, class Owner>
+	void on(const char* object, const char* param, Owner* owner,
+			void (Owner::*method)(String const& name, int gameObjectInstanceID, ValueType const& value))
+	{
+		addHandler((char)MessageValueType<ValueType>::type, object, param,
+				   new MemberMessageHandler<ValueType, Owner>(owner, method));
+	}
+	
+	/** Registers a free (or static) function to be called for one kind of message, as above. */
+	template <class ValueType>
+	void on(const char* object, const char* param,
+			void (*function)(String const& name, int gameObjectInstanceID, ValueType const& value))
+	{
+		addHandler((char)MessageValueType<ValueType>::type, object, param,
+				   new FunctionMessageHandler<ValueType>(function));
+	}
+	
+	/** Other messages which haven't been parsed by the GameEngineServer class.
+	 Unlike the other handle functions this is called on the network thread. */
 	virtual void handleOther(String const& name, String const& t, String const& value);
 	
 private:
-	void handleConnectionMessage(String const& name, String const& type, String const& message);
+	enum { numValueTypes = 6, unresolvedAction = -1, maxTextLength = 63, maxMessageNames = 4096 };
+	
+	/** A message name seen on the connection, split once into its object and parameter. */
+	struct MessageName
+	{
+		enum BuiltIn { notBuiltIn, create, destroy };
+		
+		String name, object, param;
+		BuiltIn builtIn;						// create and destroy are handled by GameEngineServer itself
+		mutable int handlers[numValueTypes];	// from handlerTable for each type, 1 + the index in handlers or 0 for none, only used on the audio thread
+	};
+	
+	/** A decoded message passed from the network thread to the audio thread.
+	 Names point to MessageNames, which are never deleted, so no Strings are copied.
+	 A string value or the other name of a collision is carried in the Command itself. */
+	struct Command
+	{
+		enum Type { Connected, Disconnected, BoolMessage, IntMessage, RealMessage, StringMessage, VectorMessage, HitMessage };
+		
+		uint8 type;
+		const MessageName* name;
+		int gameObjectInstanceID;		// or the client ID for Connected and Disconnected
+		
+		union
+		{
+			bool flag;
+			int intValue;
+			double realValue;
+			float vector[3];
+			float velocity;				// of a collision
+		};
+		
+		char text[maxTextLength + 1];	// the string value or the collision's other name, nul terminated
+		
+#if GAMECON_LATENCY
+		int64 received, parsed;
+#endif
+	};
+	
+	/** Runs runAudioThread(). */
+	class AudioThread : public Thread
+	{
+	public:
+		AudioThread(GameEngineServer& engineServer) : Thread("GameEngineServer audio"), owner(engineServer) {}
+		void run() { owner.runAudioThread(); }
+		
+	private:
+		GameEngineServer& owner;
+		
+		AudioThread(const AudioThread&);
+		AudioThread& operator=(const AudioThread&);
+	};
+	
+	enum { commandQueueSize = 4096 };
+	
+	/** A name declared by a binary client, interned the first time it's used as a message name. */
+	struct BinaryName
+	{
+		BinaryName() : name(0) {}
+		
+		String text;
+		const MessageName* name;
+	};
+	
+	PointerDictionary<MessageName> messageNames;	// every message name seen so far, looked up straight from the parser's buffer
+	OwnedArray<MessageName> messageNameStorage;
+	bool messageNamesFull;							// logged once when the first name is dropped
+	bool textTooLong;								// ..and the first string
+	OwnedArray< Array<BinaryName> > binaryNames;	// for each client (by ID - 1), indexed by the name index used in binary frames
+	LockFreeQueue<Command> commands;				// written by the network thread, read by the audio thread
+	AudioThread audioThread;
+	TickScheduler tickScheduler;					// paces the audio thread
+	Atomic<int> numConnections;						// kept by the network thread, the audio thread sleeps while it's 0
+	OwnedArray<MessageHandler> handlers;			// registered with on()
+	OwnedArray<MemoryBlock> handlerNames;			// copies of the object and param names in handlerEntries
+	Array<MessageActionTable::Entry> handlerEntries;
+	ScopedPointer<MessageActionTable> handlerTable;	// rebuilt as handlers are added, the action is 1 + the handler index
+#if GAMECON_LATENCY
+	LatencyProbe latency;
+#endif
+	
+	void handleConnectionMessage(int clientId, TokenSpan const& name, TokenSpan const& type, TokenSpan const& message);
+	void handleConnectionFrame(int clientId, const uint8* body, int size);
+	void handleConnectionDatagram(const uint8* body, int size);
+	void handleConnectionOpened(int clientId);
+	void handleConnectionClosed(int clientId);
+	void post(Command const& command);
+	void runAudioThread();
+	void dispatchCommands();
+	void handleIntMessage(const MessageName* name, int gameObjectInstanceID, int data);
+	MessageHandler* getHandler(const MessageName* name, int commandType) const;
+	void callHandler(MessageHandler* handler, Command const& command);
+	void addHandler(char type, const char* object, const char* param, MessageHandler* handler);
+	
+	void declareBinaryName(Array<BinaryName>& names, int index, TokenSpan const& name);
+	const MessageName* getMessageName(TokenSpan const& name);
+	
+	bool setText(Command& command, const char* text, int length);
+	
+	static void splitName(String const& name, String& object, String& param);
+	
+	GameEngineServer(const GameEngineServer&);
+	GameEngineServer& operator=(const GameEngineServer&);
 };
 
 /** @mainpage
@@ -155,16 +397,22 @@ private:
  
  Typically you would implement a class which inherits from GameEngineServer, you should ensure 
  that only one of these objects will be instantiated within your app. There are three pure virtual functions you 
- must implement from ConnectionServer. The first two are ConnectionServer::handleConnect() and
- ConnectionServer::handleDisconnect() which repsond to the network connection being made and lost respectively. The handleConnect()
+ must implement. The first two are GameEngineServer::handleConnect() and
+ GameEngineServer::handleDisconnect() which repsond to a client's network connection being made and lost respectively.
+ Several clients (e.g., the game plus bots or replay feeds) may be connected at once, each has its own ID. The first handleConnect()
  function is a good place to initialise your sound engine, in particular it is an ideal place to initialise
  the <a href=http://www.fmod.org/>FMOD</a> event system since it helps ensure that calls to 
- <a href=http://www.fmod.org/>FMOD</a> are all made on the same "network" thread. Similarly
- handleDisconnect() is a good place to shutdown and clear up the sound engine. The third pure virtual
- function from ConnectionServer is ConnectionServer::tick() which is called regularly on the network thread. This
+ <a href=http://www.fmod.org/>FMOD</a> are all made on the same "audio" thread. Similarly
+ the last handleDisconnect() is a good place to shutdown and clear up the sound engine. The third pure virtual
+ function is GameEngineServer::tick() which is called once per frame on the audio thread while a client is connected. This
  should/could be used to send "update" (or similar) messages to the sound engine. Commonly this would be assumed to
  be every "frame" from the game. It is the ideal place to call update() messages for <a href=http://www.fmod.org/>FMOD</a>.
  
+ The network thread only reads and decodes messages, they are queued for the audio thread which
+ calls the handle functions at the start of the next frame, before tick(). Your class starts the audio
+ thread with GameEngineServer::startAudioThread() at the end of its constructor and stops it with
+ GameEngineServer::stopAudioThread() at the start of its destructor.
+ 
  Then you have the option to implement various virtual functions from GameEngineServer, these are:
  - GameEngineServer::handleCreate()
  - GameEngineServer::handleDestroy()
@@ -178,7 +426,7 @@ private:
  
  These can respond to various actions and changes from the game engine in terms of object creation and deletion
  (which can then be used to create and delete sound events for example), object position and movement within the game, 
- and collisions between objects in the game. Again these are all called on the network thread so are safe to use
+ and collisions between objects in the game. Again these are all called on the audio thread so are safe to use
  with <a href=http://www.fmod.org/>FMOD</a> without using critical sections etc. as prescribed in the <a href=http://www.fmod.org/>FMOD</a> documentation.
  
  @section FurtherInfo Further information
@@ -189,8 +437,9 @@ private:
  
  @section Introduction Introduction
  
- In this version all network traffic is ASCII encoded, including floats and doubles (so there may be
- some issues with rounding to take care of).
+ By default all network traffic is ASCII encoded, including floats and doubles (so there may be
+ some issues with rounding to take care of). A client can instead negotiate the compact binary framing
+ described in the @ref Binary section below, the ASCII format remains the fallback.
  
  The general format of a message is a space-separated message:
  @code <message-name> <message-type> <message-content> @endcode
@@ -435,7 +684,75 @@ private:
  @section Collision Collision
  
  tba
-  
+ 
+ @section Binary Binary framing
+ 
+ The ASCII format costs a tokenise and a string to number conversion for every value. A client
+ sending a lot of vectors can switch its connection to binary frames by sending the ASCII line:
+ @code gamecon.protocol s binary @endcode
+ The server echoes the same line back once the switch has been made. The client should wait for the echo
+ before sending anything else (if it never arrives the server doesn't support binary frames and the
+ client should stay with ASCII). Everything after the line is then sent as frames:
+ 
+ <table>
+ <tr><td>1 byte</td><td>marker, always @c 0xC5</td></tr>
+ <tr><td>1 byte</td><td>body length (the number of bytes after this one, 1-255)</td></tr>
+ <tr><td>1 byte</td><td>type, the same characters as the ASCII <b><em><tt><message-type></tt></em></b> (lower case only) or @c n</td></tr>
+ <tr><td>varint</td><td>name index</td></tr>
+ <tr><td>zigzag varint</td><td>object id (0 if the object has no id)</td></tr>
+ <tr><td>...</td><td>the value, depending on the type</td></tr>
+ </table>
+ 
+ Varints are unsigned LEB128 (7 bits per byte, least significant first, high bit set on all but the
+ last byte). Signed values are zigzag encoded first. Floats and doubles are raw IEEE 754, little endian.
+ 
+ Names are not sent in every frame. A name is declared once with an @c n frame whose body is the type,
+ the varint name index and then the UTF-8 <b><em><tt><message-name></tt></em></b> (no id follows). Later
+ frames refer to it by index. The values for each type are:
+ - @c b : 1 byte, 0 or 1;
+ - @c i : zigzag varint;
+ - @c r : 8 byte double;
+ - @c s : varint byte count followed by the UTF-8 string;
+ - @c v : three 4 byte floats, x, y then z; and
+ - @c c : varint name index of the other object followed by a 4 byte float velocity.
+ 
+ For example, once @c char.vel has been declared as name index 4 the vector message
+ @code char.vel V "-4882 0.003 -0.342 1.125" @endcode
+ would be sent as the 18 byte frame:
+ @code C5 10 76 04 A3 4C <0.003> <-0.342> <1.125> @endcode
+ 
+ @section Datagrams Vector datagrams
+ 
+ Vectors are only ever wanted at their latest value, so if the server was given a datagram port they can
+ be sent over UDP instead, where a lost packet doesn't hold up the ones after it. Everything else
+ (creating and destroying objects, collisions, strings etc.) should stay on the TCP connection. Each
+ datagram is laid out as:
+ 
+ <table>
+ <tr><td>1 byte</td><td>marker, always @c 0xC6</td></tr>
+ <tr><td>varint</td><td>sender id, chosen by the client and the same for all its datagrams</td></tr>
+ <tr><td>varint</td><td>sequence number, one more than the sender's previous datagram</td></tr>
+ <tr><td>...</td><td>any number of vector records</td></tr>
+ </table>
+ 
+ Where each vector record is the varint byte count and UTF-8 <b><em><tt><message-name></tt></em></b>, the zigzag
+ varint object id (0 if the object has no id) and then the three 4 byte floats. A datagram with a sequence
+ number no newer than the last one received from the same sender arrived out of order and is discarded.
+ Datagrams pass through the same queue as messages from the TCP connections so they reach
+ GameEngineServer::handleVector() on the audio thread in the usual way.
+ 
+ @section Ping Ping
+ 
+ A client can measure how far behind the server is reading by sending the ASCII line:
+ @code gamecon.ping s <token> @endcode
+ The server answers on the same connection as soon as the line has been read (it isn't passed to the
+ handle functions) with the token, the number of vector datagrams received and the number of those which
+ were discarded as stale:
+ @code gamecon.ping s "<token> <datagrams> <stale-datagrams>" @endcode
+ The network thread waits whenever the queue to the audio thread is full, so a slow audio thread shows
+ up in the time the answer takes too. A connection which has switched to binary frames can't send the
+ ping, so a client using binary frames should ping over a second, ASCII, connection.
+ 
  */
 
 #endif // GAMEENGINESERVER_H
\ No newline at end of file
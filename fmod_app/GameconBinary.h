@@ -0,0 +1,224 @@
+#ifndef GAMECONBINARY_H
+#define GAMECONBINARY_H
+
+#include <juce/juce.h>
+
+/** Reading and writing of the compact binary Gamecon framing.
+ See the @ref Binary section of the @ref DataFormat page for the layout. */
+namespace GameconBinary
+{
+	/** The first byte of every binary frame. */
+	static const uint8 frameMarker = 0xc5;
+
+	/** The marker byte and the body length byte. */
+	static const int headerSize = 2;
+
+	/** The body length is a single byte. */
+	static const int maxBodySize = 255;
+
+	/** The ASCII line a client sends to switch its connection to binary frames.
+	 The server echoes it back once the switch has been made. */
+	static const char* const switchMessage = "gamecon.protocol s binary";
+
+	/** The name of the ASCII message a client sends to measure how far behind the server is.
+	 The server answers on the same connection as soon as it has read the line, see @ref Ping. */
+	static const char* const pingName = "gamecon.ping";
+
+	/** Frame type declaring the name for a name index. */
+	static const uint8 typeName = 'n';
+
+	/** The first byte of every vector datagram sent over UDP. */
+	static const uint8 datagramMarker = 0xc6;
+
+	/** The largest datagram which is read, anything longer is truncated. */
+	static const int maxDatagramSize = 65536;
+
+	/** Reads values from the body of one frame.
+	 Reading past the end of the body returns zeros and sets the failed() flag
+	 rather than touching memory outside the frame. */
+	class Reader
+	{
+	public:
+		Reader(const uint8* body, int size)
+		:	data(body),
+			remaining(size),
+			error(false)
+		{
+		}
+
+		bool failed() const { return error; }
+		int getNumBytesRemaining() const { return remaining; }
+
+		uint8 readByte()
+		{
+			if(remaining < 1)
+			{
+				error = true;
+				return 0;
+			}
+
+			remaining--;
+			return *data++;
+		}
+
+		/** Reads an unsigned LEB128 varint. */
+		uint32 readVarint()
+		{
+			uint32 value = 0;
+
+			for(int shift = 0; shift < 35; shift += 7)
+			{
+				uint8 byte = readByte();
+				value |= (uint32)(byte & 0x7f) << shift;
+
+				if((byte & 0x80) == 0)
+					return value;
+			}
+
+			error = true;
+			return 0;
+		}
+
+		/** Reads a zigzag encoded signed varint. */
+		int readSignedVarint()
+		{
+			uint32 value = readVarint();
+			return (int)(value >> 1) ^ -(int)(value & 1);
+		}
+
+		float readFloat()
+		{
+			uint32 bits = readLittleEndian32();
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		double readDouble()
+		{
+			uint64 bits = readLittleEndian32();
+			bits |= (uint64)readLittleEndian32() << 32;
+			double value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		/** Returns a pointer to the next numBytes bytes of the body, or 0 if there aren't enough. */
+		const char* readBytes(int numBytes)
+		{
+			if(numBytes < 0 || remaining < numBytes)
+			{
+				error = true;
+				return 0;
+			}
+
+			const char* bytes = (const char*)data;
+			data += numBytes;
+			remaining -= numBytes;
+			return bytes;
+		}
+
+	private:
+		const uint8* data;
+		int remaining;
+		bool error;
+
+		uint32 readLittleEndian32()
+		{
+			uint32 value = readByte();
+			value |= (uint32)readByte() << 8;
+			value |= (uint32)readByte() << 16;
+			value |= (uint32)readByte() << 24;
+			return value;
+		}
+	};
+
+	/** Builds a single frame, including its header.
+	 Writing past maxBodySize sets the failed() flag and the frame should not be sent. */
+	class Writer
+	{
+	public:
+		Writer(uint8 type)
+		:	size(headerSize),
+			error(false)
+		{
+			frame[0] = frameMarker;
+			frame[1] = 0;
+			writeByte(type);
+		}
+
+		bool failed() const { return error; }
+
+		void writeByte(uint8 byte)
+		{
+			if(size >= headerSize + maxBodySize)
+			{
+				error = true;
+				return;
+			}
+
+			frame[size++] = byte;
+		}
+
+		void writeVarint(uint32 value)
+		{
+			while(value >= 0x80)
+			{
+				writeByte((uint8)(value | 0x80));
+				value >>= 7;
+			}
+
+			writeByte((uint8)value);
+		}
+
+		void writeSignedVarint(int value)
+		{
+			writeVarint(((uint32)value << 1) ^ (uint32)(value >> 31));
+		}
+
+		void writeFloat(float value)
+		{
+			uint32 bits;
+			memcpy(&bits, &value, sizeof(bits));
+			writeLittleEndian32(bits);
+		}
+
+		void writeDouble(double value)
+		{
+			uint64 bits;
+			memcpy(&bits, &value, sizeof(bits));
+			writeLittleEndian32((uint32)bits);
+			writeLittleEndian32((uint32)(bits >> 32));
+		}
+
+		void writeBytes(const char* bytes, int numBytes)
+		{
+			for(int i = 0; i < numBytes; i++)
+				writeByte((uint8)bytes[i]);
+		}
+
+		/** Fills in the header and returns the whole frame. */
+		const uint8* getFrame()
+		{
+			frame[1] = (uint8)(size - headerSize);
+			return frame;
+		}
+
+		int getFrameSize() const { return size; }
+
+	private:
+		uint8 frame[headerSize + maxBodySize];
+		int size;
+		bool error;
+
+		void writeLittleEndian32(uint32 value)
+		{
+			writeByte((uint8)value);
+			writeByte((uint8)(value >> 8));
+			writeByte((uint8)(value >> 16));
+			writeByte((uint8)(value >> 24));
+		}
+	};
+}
+
+#endif // GAMECONBINARY_H
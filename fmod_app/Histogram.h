@@ -0,0 +1,110 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <juce/juce.h>
+
+/** Counts values (e.g., timings in microseconds) for reporting percentiles.
+
+ Values below 16 each have their own bucket; above that each power of two is
+ split into 8 buckets, so a percentile is accurate to within 12.5% whatever
+ the size of the value. Adding a value is a few instructions and never
+ allocates, so it can be used on the audio thread. */
+class Histogram
+{
+public:
+	Histogram()
+	{
+		clear();
+	}
+
+	void add(uint32 value)
+	{
+		counts[getBucket(value)]++;
+		numValues++;
+
+		if(value > maxValue)
+			maxValue = value;
+	}
+
+	int getNumValues() const { return numValues; }
+	uint32 getMax() const { return maxValue; }
+
+	/** Returns an upper bound for the value below which the given proportion
+	 (0 to 1) of the values fall, e.g., 0.99 for the 99th percentile. */
+	uint32 getPercentile(double proportion) const
+	{
+		if(numValues == 0)
+			return 0;
+
+		const int64 target = jmax((int64)1, (int64)(proportion * numValues + 0.5));
+		int64 total = 0;
+
+		for(int bucket = 0; bucket < numBuckets; bucket++)
+		{
+			total += counts[bucket];
+
+			if(total >= target)
+				return jmin(getBucketLimit(bucket), maxValue);
+		}
+
+		return maxValue;
+	}
+
+	/** Returns a one line summary such as "n=1000 p50=15012 p99=16480 max=17110". */
+	String getSummary() const
+	{
+		return "n=" + String(numValues)
+			+ " p50=" + String((int64)getPercentile(0.5))
+			+ " p99=" + String((int64)getPercentile(0.99))
+			+ " max=" + String((int64)maxValue);
+	}
+
+	/** Converts a duration from Time::getHighResolutionTicks() to whole microseconds, as a value to add(). */
+	static uint32 ticksToMicroseconds(int64 highResolutionTicks)
+	{
+		const double us = Time::highResolutionTicksToSeconds(jmax((int64)0, highResolutionTicks)) * 1000000.0;
+		return (uint32)jmin(us, 4294967295.0);
+	}
+
+	void clear()
+	{
+		zeromem(counts, sizeof(counts));
+		numValues = 0;
+		maxValue = 0;
+	}
+
+private:
+	enum { numExactBuckets = 16, subBucketBits = 3, numBuckets = numExactBuckets + (32 - 4) * (1 << subBucketBits) };
+
+	uint32 counts[numBuckets];
+	int numValues;
+	uint32 maxValue;
+
+	static int getBucket(uint32 value)
+	{
+		if(value < numExactBuckets)
+			return (int)value;
+
+		int topBit = 4;
+
+		while(topBit < 31 && (value >> (topBit + 1)) != 0)
+			topBit++;
+
+		const int subBucket = (int)(value >> (topBit - subBucketBits)) & ((1 << subBucketBits) - 1);
+		return numExactBuckets + (topBit - 4) * (1 << subBucketBits) + subBucket;
+	}
+
+	/** The largest value which falls in a bucket. */
+	static uint32 getBucketLimit(int bucket)
+	{
+		if(bucket < numExactBuckets)
+			return (uint32)bucket;
+
+		const int topBit = 4 + (bucket - numExactBuckets) / (1 << subBucketBits);
+		const int subBucket = (bucket - numExactBuckets) % (1 << subBucketBits);
+		const uint32 start = ((uint32)1 << topBit) + ((uint32)subBucket << (topBit - subBucketBits));
+		return start + ((uint32)1 << (topBit - subBucketBits)) - 1;
+	}
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,89 @@
+#ifndef LATENCYPROBE_H
+#define LATENCYPROBE_H
+
+#include <juce/juce.h>
+#include "Histogram.h"
+
+/** Set GAMECON_LATENCY to 1 (e.g., in the project's preprocessor definitions) to
+ time every message from the socket read to the return of its handle function.
+ When it's 0 (the default) none of the timing code is compiled. */
+#ifndef GAMECON_LATENCY
+ #define GAMECON_LATENCY 0
+#endif
+
+/** Latency histograms for each type of message, split into the stages a message passes through.
+
+ The network thread stamps a message when the read which brought it in
+ returned and when it was decoded, the audio thread when it was taken off
+ the queue and when its handle function (and so its FMOD calls) returned.
+ All four stamps reach the audio thread with the message, so only that thread
+ writes the histograms and they need no locks.
+
+ requestDump() can be called on any thread; the histograms are logged and
+ cleared by the audio thread at the end of its next tick.
+ */
+class LatencyProbe
+{
+public:
+	enum Stage
+	{
+		parseStage,		///< socket read to decoded
+		queueStage,		///< decoded to taken off the queue by the audio thread
+		handleStage,	///< the handle function, including its FMOD calls
+		totalStage,		///< socket read to the handle function returning
+		numStages
+	};
+
+	enum { maxTypes = 16 };
+
+	/** The monotonic clock used for the stamps. */
+	static int64 now() { return Time::getHighResolutionTicks(); }
+
+	/** Records the stamps of one message of the given type (0 to maxTypes-1). */
+	void record(int type, int64 received, int64 parsed, int64 dispatched, int64 handled)
+	{
+		if(!isPositiveAndBelow(type, (int)maxTypes))
+			return;
+
+		Histogram* stages = histograms[type];
+		stages[parseStage].add(Histogram::ticksToMicroseconds(parsed - received));
+		stages[queueStage].add(Histogram::ticksToMicroseconds(dispatched - parsed));
+		stages[handleStage].add(Histogram::ticksToMicroseconds(handled - dispatched));
+		stages[totalStage].add(Histogram::ticksToMicroseconds(handled - received));
+	}
+
+	/** Asks for the histograms to be logged, from any thread. */
+	void requestDump()
+	{
+		dumpRequested = 1;
+	}
+
+	/** Logs and clears the histograms if requestDump() has been called since the last dump.
+	 @param typeNames	The name of each type, or 0 for types which shouldn't be logged. */
+	void dumpIfRequested(const char* const* typeNames, int numTypes)
+	{
+		if(dumpRequested.exchange(0) == 0)
+			return;
+
+		static const char* const stageNames[numStages] = { "parse", "queue", "handle", "total" };
+
+		for(int type = 0; type < jmin(numTypes, (int)maxTypes); type++)
+		{
+			if(typeNames[type] == 0 || histograms[type][totalStage].getNumValues() == 0)
+				continue;
+
+			for(int stage = 0; stage < numStages; stage++)
+			{
+				Logger::outputDebugString("Latency(us) " + String(typeNames[type]) + " " + stageNames[stage] + ": "
+										  + histograms[type][stage].getSummary());
+				histograms[type][stage].clear();
+			}
+		}
+	}
+
+private:
+	Histogram histograms[maxTypes][numStages];
+	Atomic<int> dumpRequested;
+};
+
+#endif // LATENCYPROBE_H
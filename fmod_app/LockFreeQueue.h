@@ -0,0 +1,66 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <juce/juce.h>
+
+/** A fixed size first-in-first-out queue for one writing thread and one reading thread.
+
+ Neither push() nor pop() locks or allocates, so the queue can be written
+ from an FMOD callback or a network thread and read from the thread calling
+ tick(). The elements are copied with memcpy, so only use it for simple types. */
+template<class ElementType>
+class LockFreeQueue
+{
+public:
+	/** @param capacity	The most elements which can be waiting at once. */
+	LockFreeQueue(int capacity)
+	:	fifo(capacity + 1),
+		buffer(capacity + 1)
+	{
+	}
+
+	/** Adds an element to the back of the queue.
+	 @return false if the queue is full, in which case the element isn't added. */
+	bool push(ElementType const& element)
+	{
+		int start1, size1, start2, size2;
+		fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+		if(size1 + size2 == 0)
+			return false;
+
+		memcpy(buffer + (size1 > 0 ? start1 : start2), &element, sizeof(ElementType));
+		fifo.finishedWrite(1);
+		return true;
+	}
+
+	/** Takes the element at the front of the queue.
+	 @return false if the queue is empty. */
+	bool pop(ElementType& element)
+	{
+		int start1, size1, start2, size2;
+		fifo.prepareToRead(1, start1, size1, start2, size2);
+
+		if(size1 + size2 == 0)
+			return false;
+
+		memcpy(&element, buffer + (size1 > 0 ? start1 : start2), sizeof(ElementType));
+		fifo.finishedRead(1);
+		return true;
+	}
+
+	/** The number of elements waiting, only exact when called from the reading thread. */
+	int getNumReady() const { return fifo.getNumReady(); }
+
+	/** Empties the queue. Only safe when neither thread is using it. */
+	void reset() { fifo.reset(); }
+
+private:
+	AbstractFifo fifo;
+	HeapBlock<ElementType> buffer;
+
+	LockFreeQueue(const LockFreeQueue&);
+	LockFreeQueue& operator=(const LockFreeQueue&);
+};
+
+#endif // LOCKFREEQUEUE_H
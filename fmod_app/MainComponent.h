@@ -41,8 +41,12 @@
 #include "headers.h"
 
 #include "GameEngineServer.h"
-#include "PointerDictionary.h"
+#include "EventTable.h"
+#include "ObjectKeyTable.h"
 #include "VectorData.h"
+#include "ReverbZones.h"
+#include "VoiceBudget.h"
+#include "CollisionCoalescer.h"
 
 /** Designed to work with the @c shootergame.app or @c shootergame.exe provided.
  
@@ -108,16 +112,55 @@ namespace Strings
     static const char* BirdsFlying = "shooter/atmosphere/birdsFlying";
     static const char* RunningBreath = "shooter/atmosphere/breathing";
     
-//FMOD Parameters
-    static const char* Velocity = "velocity";
-    static const char* ExplodeDistance = "explodeDistance";
-    static const char* RunningParam = "runningCounter";
-    static const char* BirdCounter = "birdCounter";
-    
 //Reverb
     static const char* UnderBridgeReverb = "underBridgeReverb";
 }
 
+//Keys of the one-shot events in eventTable, resolved when the FEV is loaded
+namespace Sounds
+{
+    enum Category
+    {
+        Footsteps,
+        BulletImpacts,
+        GunSounds,
+        GrenadeLauncherSounds,
+        WaterSounds,
+        Collisions,
+        Explosions
+    };
+    static const char* CategoryNames[] = { "footsteps", "bullet impacts", "gun", "grenade launcher", "water", "collisions", "explosions" };
+    
+    //Footsteps and bullet impacts, footsteps have no glass
+    enum Surface { Dirt, Wood, Metal, Concrete, Sand, Water, Glass };
+    static const char* SurfaceNames[] = { "dirt", "wood", "metal", "concrete", "sand", "water", "glass" };
+    
+    //Gun and grenade launcher sounds
+    enum GunAction { Fire, Reload, Empty };
+    static const char* GunActionNames[] = { "fire", "reload", "empty" };
+    
+    enum WaterAction { Impact, Jump };
+    static const char* WaterActionNames[] = { "impact", "jump" };
+    
+    static const char* CollisionNames[] = { "brick", "inkcan", "barrel", "chair", "noticeboard", "cabinet", "tyre" };
+    
+    enum Explosion { Explode, ExplodeRing };
+    static const char* ExplosionNames[] = { "explode", "explodeRing" };
+}
+
+//The FMOD event parameters, written by their index in Names so the ParameterCache never compares names
+namespace Parameters
+{
+    enum Parameter { Velocity, ExplodeDistance, RunningCounter, BirdCounter };
+    static const char* Names[] = { "velocity", "explodeDistance", "runningCounter", "birdCounter" };
+}
+
+//The presets of the reverb zones, set when the FEV is loaded
+namespace Reverbs
+{
+    enum Preset { SmallHouse, LargeHouse, UnderBridge };
+}
+
 namespace Globals {
     //Whether the soldier is in the water
     //Whether they're using the grenadelauncher or gun
@@ -131,9 +174,14 @@ namespace Globals {
 
 //The amount of ticks that must have past since the last gun shot for the birds to fly away again
 #define birdCounterTrigger 750
-
-//typedef for storing a dictionary of Vector locations and FMOD events related to each object
-typedef PointerDictionary<VectorData> VectorDictionary;
+//The number of instances of each one-shot event created when FMOD starts, more are added if needed
+#define eventPoolSize 4
+//The most reverb zones which are heard at once, the nearest to the camera
+#define reverbPoolSize 4
+//The most one-shot events which play at once, well under the channels given to FMOD so the loops always have room
+#define voiceBudgetSize 64
+//The milliseconds after a collision of an object with a surface in which only harder hits of the two play again
+#define collisionWindow 80
 
 class MainComponent  :	public Component,
                         public GameEngineServer
@@ -150,13 +198,28 @@ private:
     //Global to allow param control in footsteps function, but create in handleCreate
     Event* runningEvent;
     
-	EventReverb* underBridgeReverb1;
-    EventReverb* underBridgeReverb2;
-    EventReverb* smallHouseReverb;
-    EventReverb* largeHouseReverb;
+    //The reverbs of the houses and under the bridge, the nearest few share a pool of EventReverbs
+    ReverbZones reverbZones;
     
+    //Instances of the footstep, gun, impact and collision events, so they aren't looked up every time one plays
+    EventPools eventPools;
+    //The pools of those events by Sounds::Category and key
+    EventTable eventTable;
+    //Decides which of those events play when too many are wanted at once
+    VoiceBudget voiceBudget;
+    //Drops the rattle of small hits which follows a collision, e.g., debris settling after a grenade
+    CollisionCoalescer collisionCoalescer;
+    
+    //Handles for every (name, gameObjectInstanceID) pair, interned once in handleCreate
+    ObjectKeyTable objectKeys;
     //Contains the vector data of all objects in the game
-    VectorDictionary objects;
+    ObjectStore objectStore;
+    //The store handle for each object, indexed by handle from objectKeys
+    Array<ObjectStore::Handle> objects;
+    //Kept from the camera vectors so objects out of earshot aren't updated
+    Vector3 listenerPos;
+    //FMOD is started by the first client to connect and shut down when the last one leaves
+    int numClients;
     
     enum Commands
 	{
@@ -165,15 +228,51 @@ private:
     
 public:
 	MainComponent ()
-	:	eventsystem(0),
-    atmos(0)
+	:	GameEngineServer(60000, 64, 60001), //Vectors may also be sent as UDP datagrams to port 60001
+    eventsystem(0),
+    atmos(0),
+    voiceBudget(voiceBudgetSize),
+    collisionCoalescer(collisionWindow),
+    numClients(0)
 	{
-		// launch the game app
-		launchGame();
+        listenerPos.x = listenerPos.y = listenerPos.z = 0;
+        objectStore.getParameters().setNames(Parameters::Names, numElementsInArray(Parameters::Names));
+        registerHandlers();
+        
+        //-capture <file> records the network traffic, -replay <file> [-fast] plays a recording back instead of launching the game
+        StringArray args;
+        args.addTokens(JUCEApplication::getCommandLineParameters(), true);
+        
+        const int captureIndex = args.indexOf("-capture");
+        const int replayIndex = args.indexOf("-replay");
+        
+        if(captureIndex >= 0 && captureIndex + 1 < args.size())
+        {
+            const File captureFile(File::getCurrentWorkingDirectory().getChildFile(args[captureIndex + 1].unquoted()));
+            
+            if(!startCapture(captureFile))
+                Logger::outputDebugString("Can't capture to " + captureFile.getFullPathName());
+        }
+        
+        if(replayIndex >= 0 && replayIndex + 1 < args.size())
+        {
+            startReplay(File::getCurrentWorkingDirectory().getChildFile(args[replayIndex + 1].unquoted()),
+                        !args.contains("-fast"));
+        }
+        else
+        {
+            // launch the game app
+            launchGame();
+        }
+        
+        //Everything tick() and the handlers use is set up now
+        startAudioThread();
 	}
 	
 	~MainComponent ()
 	{
+        //Stop tick() and the handlers before the members they use go
+        stopAudioThread();
 		deleteAllChildren();
 	}
     
@@ -194,27 +293,28 @@ public:
 		// load an event file
 		ERRCHECK(eventsystem->load(Strings::FEVFile, 0, 0));
         
-		// create reverb
-		ERRCHECK(eventsystem->createReverb(&underBridgeReverb1));
-        ERRCHECK(eventsystem->createReverb(&underBridgeReverb2));
-        ERRCHECK(eventsystem->createReverb(&smallHouseReverb));
-        ERRCHECK(eventsystem->createReverb(&largeHouseReverb));
+#if FMOD_MOCK
+        //The mock can't read the FEV file, so tell it which events loop (handleDisconnect() waits for the atmos to stop)
+        eventsystem->setMockDuration((Strings::AtmosLocation+"atmos").toUTF8(), 0);
+        eventsystem->setMockDuration((Strings::AtmosLocation+Strings::ElectricBox).toUTF8(), 0);
+#endif
+        
+		// create the pool of reverbs, the zones are placed as their positions arrive
+		reverbZones.setEventSystem(eventsystem, reverbPoolSize);
         
-
         // get the preset reverb property
 		FMOD_REVERB_PROPERTIES smallHouseProperties = FMOD_PRESET_LIVINGROOM;
         FMOD_REVERB_PROPERTIES largeHouseProperties = FMOD_PRESET_ROOM;
 
-		// ..and apply them to our reverb
-        ERRCHECK(smallHouseReverb->setProperties(&smallHouseProperties));
-        ERRCHECK(largeHouseReverb->setProperties(&largeHouseProperties));
+		// ..and use them for the zones
+        reverbZones.setPreset(Reverbs::SmallHouse, smallHouseProperties);
+        reverbZones.setPreset(Reverbs::LargeHouse, largeHouseProperties);
         
         // get the reverb properties set up in FMOD designer
         FMOD_REVERB_PROPERTIES underBridgeProperties;
         ERRCHECK(eventsystem->getReverbPreset(Strings::UnderBridgeReverb, & underBridgeProperties, 0));
-		// ..and apply them to our reverb
-		ERRCHECK(underBridgeReverb1->setProperties(&underBridgeProperties));
-        ERRCHECK(underBridgeReverb2->setProperties(&underBridgeProperties));
+		// ..and use them for the zones
+        reverbZones.setPreset(Reverbs::UnderBridge, underBridgeProperties);
 		
 		// set the "ambient" reverb
 		FMOD_REVERB_PROPERTIES ambientProperties = FMOD_PRESET_PLAIN;
@@ -225,24 +325,78 @@ public:
         ERRCHECK(eventsystem->getEvent(Strings::BirdsFlying,
                                        FMOD_EVENT_DEFAULT, 
                                        &birdsFlying));
+        
+        buildEventTable();
+        buildVoiceBudget();
 	}
+    
+    //Resolves the one-shot events and creates their instances, an event which isn't in the FEV file is left out
+    void buildEventTable()
+    {
+        eventPools.setEventSystem(eventsystem);
+        
+        eventTable.addCategory(Sounds::Footsteps, Strings::FootstepLocation,
+                               Sounds::SurfaceNames, Sounds::Glass, eventPools, eventPoolSize);
+        eventTable.addCategory(Sounds::BulletImpacts, Strings::GunsLocation + Strings::Bullet + "/",
+                               Sounds::SurfaceNames, numElementsInArray(Sounds::SurfaceNames), eventPools, eventPoolSize);
+        //Machine gun reloading has a longer animation so a longer version of the reloading sound was used
+        eventTable.addCategory(Sounds::GunSounds, Strings::GunsLocation + "gun",
+                               Sounds::GunActionNames, numElementsInArray(Sounds::GunActionNames), eventPools, eventPoolSize);
+        eventTable.addCategory(Sounds::GrenadeLauncherSounds, Strings::GunsLocation + "grenade",
+                               Sounds::GunActionNames, numElementsInArray(Sounds::GunActionNames), eventPools, eventPoolSize);
+        eventTable.addCategory(Sounds::WaterSounds, Strings::WaterLocation,
+                               Sounds::WaterActionNames, numElementsInArray(Sounds::WaterActionNames), eventPools, eventPoolSize);
+        eventTable.addCategory(Sounds::Collisions, Strings::CollisionsLocation,
+                               Sounds::CollisionNames, numElementsInArray(Sounds::CollisionNames), eventPools, eventPoolSize);
+        eventTable.addCategory(Sounds::Explosions, Strings::GunsLocation,
+                               Sounds::ExplosionNames, numElementsInArray(Sounds::ExplosionNames), eventPools, eventPoolSize);
+    }
+	
+    //Sets how important each category of one-shot is and how many of it can play at once
+    void buildVoiceBudget()
+    {
+        //The player's own sounds and explosions matter most, debris the least
+        voiceBudget.setCategory(Sounds::GunSounds, 5, 4);
+        voiceBudget.setCategory(Sounds::GrenadeLauncherSounds, 5, 4);
+        voiceBudget.setCategory(Sounds::Explosions, 6, 4);
+        voiceBudget.setCategory(Sounds::Footsteps, 3, 4);
+        voiceBudget.setCategory(Sounds::WaterSounds, 3, 4);
+        voiceBudget.setCategory(Sounds::BulletImpacts, 2, 12);
+        voiceBudget.setCategory(Sounds::Collisions, 1, 12);
+    }
 	
 	void shutdownFMODEvent()
 	{
-		ERRCHECK(underBridgeReverb1->release());
-        ERRCHECK(underBridgeReverb2->release());
-        ERRCHECK(smallHouseReverb->release());
-        ERRCHECK(largeHouseReverb->release());
+        voiceBudget.logStats(Sounds::CategoryNames, numElementsInArray(Sounds::CategoryNames));
+        voiceBudget.clear();
+        collisionCoalescer.logStats();
+        collisionCoalescer.clear();
+        objectStore.getParameters().logStats();
+        objectStore.getParameters().clear();
+        eventPools.logStats();
+        eventTable.clear();
+        eventPools.clear();
+        
+        reverbZones.clear();
 		ERRCHECK(eventsystem->release());
 		eventsystem = 0;
 	}	
 	
 	void tick()
 	{
-		// this is called by the ConnectionServer thread every few milliseconds
+		// this is called by the GameEngineServer audio thread once per frame, after that frame's messages
 		
 		if(eventsystem) // make sure we have an event system running
 		{
+            //Removes the events FMOD reported finished during the last update
+            objectStore.reapFinished();
+            //Applies this tick's moves to the playing events before FMOD updates
+            objectStore.flushMoved(listenerPos);
+            //Pauses the water and hum loops out of earshot of the camera, and resumes them when it comes back
+            objectStore.pauseOutOfRange(listenerPos);
+            //Gives the pooled reverbs to the zones nearest the camera
+            reverbZones.update(listenerPos);
+            
 			ERRCHECK(eventsystem->update()); // need to call this regularly, docs say once per "frame"
             
             //Checks if soldier is running, increases counter
@@ -265,9 +419,7 @@ public:
                 if (birdEvent != nullptr)
                 {
                     //Makes the bird sounds fade in after they have flown away, but stops counting once the flying away sound is ready to be triggered again
-                    EventParameter* param;
-                    ERRCHECK(birdEvent->getParameter(Strings::BirdCounter, &param));
-                    ERRCHECK(param->setValue(Globals::birdCounter));
+                    objectStore.getParameters().setValue(birdEvent, Parameters::BirdCounter, Globals::birdCounter);
                 }
             }
             
@@ -282,24 +434,74 @@ public:
                     runningEvent->getPaused(&test);
                     if (!test)
                     {
-                        EventParameter* param;
-                        ERRCHECK(runningEvent->getParameter(Strings::RunningParam, &param));
-                        ERRCHECK(param->setValue(Globals::runningCounter));
+                        //Only written when the counter has changed, it stays put while the soldier is rested
+                        objectStore.getParameters().setValue(runningEvent, Parameters::RunningCounter, Globals::runningCounter);
                     }
                 }
             }  
 		}
 	}
     
-    //Used to give each instance of a barrel or brick etc. a unique name for storing in positions dictionary
-    String makeUniqueString(String const& name, int gameObjectInstanceID)
-	{
-		return name + String(gameObjectInstanceID);
-	}
+    //Creates the vector data for an object. Unique objects such as the soldier are stored with an id of 0
+    VectorData createObject(String const& name, int gameObjectInstanceID)
+    {
+        int handle = objectKeys.intern(name, gameObjectInstanceID);
+        ObjectStore::Handle object = objectStore.create();
+        
+        if (handle < objects.size())
+        {
+            //Replaces an object which was created twice, this stops its events
+            objectStore.destroy(objects[handle]);
+            objects.set(handle, object);
+        }
+        else
+            objects.add(object);
+        
+        return VectorData(&objectStore, object.index);
+    }
+    
+    //Looks up the vector data for an object without building a string, isValid() is false if it hasn't been created
+    VectorData getObject(String const& name, int gameObjectInstanceID = 0)
+    {
+        ObjectStore::Handle object = objects[objectKeys.find(name, gameObjectInstanceID)];
+        
+        if (objectStore.isValid(object))
+            return VectorData(&objectStore, object.index);
+        
+        return VectorData();
+    }
+    
+    //Removes the vector data for an object, the store stops its events
+    void destroyObject(String const& name, int gameObjectInstanceID)
+    {
+        int handle = objectKeys.find(name, gameObjectInstanceID);
+        
+        if (handle != ObjectKeyTable::invalidHandle)
+        {
+            reverbZones.removeZone(handle);
+            collisionCoalescer.forget(handle);
+            objectStore.destroy(objects[handle]);
+            objects.set(handle, ObjectStore::Handle());
+            objectKeys.release(handle);
+        }
+    }
+    
+    void destroyAllObjects()
+    {
+        reverbZones.clearZones();
+        collisionCoalescer.forgetAll();
+        objectStore.clear();
+        objects.clear();
+        objectKeys.clear();
+    }
 	
 	
-	void handleConnect()
+	void handleConnect(int clientId)
 	{
+        //Other clients (bots, replay feeds) share the sound engine started by the first
+        if (numClients++ > 0)
+            return;
+        
 		initFMODEvent();
 		
         String atmosEvent = Strings::AtmosLocation+"atmos";
@@ -308,33 +510,38 @@ public:
 		ERRCHECK(atmos->start());		
         
         //Create vector data pointers for bullet and grenade, No handleCreate is ever called for them, but their vectordata is important
-        objects.add(Strings::Bullet, new VectorData());
-        objects.add(Strings::Grenade, new VectorData());
+        createObject(Strings::Bullet, 0);
+        createObject(Strings::Grenade, 0);
         
         //Creates vector data for electricity pylon for hum
-        objects.add(Strings::ElectricBox, new VectorData());
+        VectorData electricBox = createObject(Strings::ElectricBox, 0);
         //Position electric box
-        VectorData* electricBox = objects.get(Strings::ElectricBox);
         Vector3* vector = new Vector3();
         vector->x = -63.6690102;
         vector->y = -2.22161102;
         vector->z = -123.804001;
-        electricBox->setVectors (vector, nullptr, nullptr);
+        electricBox.setVectors(vector, nullptr, nullptr);
         String electricString = Strings::AtmosLocation+Strings::ElectricBox;
         Event* event;
         ERRCHECK(eventsystem->getEvent(electricString.toUTF8(),
                                        FMOD_EVENT_DEFAULT, 
                                        &event));
         
-        electricBox->addEvent(event);
+        electricBox.addLoopingEvent(event);
         ERRCHECK(event->start());
         
         //Sets the river counter, used to give different rivers a different sound
         Globals::riverCounter = 0;
 	}
 	
-	void handleDisconnect()
+	void handleDisconnect(int clientId)
 	{
+        if (--numClients > 0)
+            return;
+        
+        //Logs how long each type of message took to handle, if GAMECON_LATENCY is set
+        requestLatencyDump();
+        
 		// see what state the event is in now...
 		FMOD_EVENT_STATE initialState, newState;
 		ERRCHECK(atmos->getState(&initialState));
@@ -356,13 +563,13 @@ public:
 		}
 		while(initialState == newState); // exit the loop if the state changes (i.e., it has stopped)
 
-        objects.clearAndDelete();
+        destroyAllObjects();
         
         //Shuts down FMOD
 		shutdownFMODEvent();
         
         // this calls handleCommandMessage with argument Quit but executes on the
-		// message thread rather than the network thread..
+		// message thread rather than the audio thread..
 		// close this Juce app when the game disconnects
 		postCommandMessage(Quit);
 	}
@@ -401,24 +608,18 @@ public:
 	 */
 	void handleCreate(String const& name, int gameObjectInstanceID)
 	{
-        String uniqueString;
+        //Interns a handle for all repeated objects, there is only one soldier and camera so they don't need their id
         if (name == Strings::Soldier || name == Strings::Camera)
-        {
-            uniqueString = name;
-        }
-        else
-            uniqueString = makeUniqueString(name, gameObjectInstanceID);
-        //Creates unique names for all repeated objects
+            gameObjectInstanceID = 0;
         
         //Adds items to objects so they can be accessed
-        
-        objects.add(uniqueString, new VectorData());
+        VectorData object = createObject(name, gameObjectInstanceID);
         
         
         if (name == Strings::Soldier)
         {
-            VectorData* soldier = objects.get(uniqueString);
-            if (soldier)
+            VectorData soldier = object;
+            if (soldier.isValid())
             {
                 //Adds randomly positioned bird sounds which follow the soldier but trigger at random distances/3d positions
                 String birds = Strings::AtmosLocation + "birds";
@@ -427,11 +628,10 @@ public:
                 ERRCHECK(eventsystem->getEvent(birds.toUTF8(),
                                                FMOD_EVENT_DEFAULT,
                                                &birdEvent));
-                EventParameter* birdParam;
-                ERRCHECK(birdEvent->getParameter(Strings::BirdCounter, &birdParam));
-                ERRCHECK(birdParam->setValue(Globals::birdCounter));
+                //Written even if unchanged, FMOD may have handed back an instance the cache knows from before
+                objectStore.getParameters().setValue(birdEvent, Parameters::BirdCounter, Globals::birdCounter, true);
                 
-                soldier->addEvent(birdEvent);
+                soldier.addEvent(birdEvent);
                 ERRCHECK(birdEvent->start());
 
                 //Adds running sounds to soldier, constantly looping, param is set every tick                   
@@ -439,11 +639,9 @@ public:
                                                    FMOD_EVENT_DEFAULT, 
                                                    &runningEvent));
                     
-                EventParameter* param;
-                ERRCHECK(runningEvent->getParameter(Strings::RunningParam, &param));
-                ERRCHECK(param->setValue(Globals::runningCounter));
+                objectStore.getParameters().setValue(runningEvent, Parameters::RunningCounter, Globals::runningCounter, true);
                 
-                soldier->addEvent(runningEvent);
+                soldier.addEvent(runningEvent);
                 ERRCHECK(runningEvent->start());
                 
             }
@@ -478,21 +676,64 @@ public:
 	 */
 	void handleDestroy(String const& name, int gameObjectInstanceID)
 	{        
-        VectorData* vecData = 0;
-
-        //Creates unique names for all objects, only really required for rivers, cans, barrels, bricks, chairs, tyres, cabinets
-        String uniqueString = makeUniqueString(name, gameObjectInstanceID);
-        
-        //Removes object from dictionary, VectorData calls stop events in the destructor, so no call needed
-        vecData = objects.remove(uniqueString);
-
-		if(vecData)
-			delete vecData;
+        //Removes object from objects, the store stops its events, so no call needed
+        destroyObject(name, gameObjectInstanceID);
 	}
 		
+    //What each message from the game does, the most specific registration wins and anything else goes to the handle functions
+    void registerHandlers()
+    {
+        on<Vector3>("camera",         "pos",      this, &MainComponent::handleCameraPos);
+        on<Vector3>("camera",         "vel",      this, &MainComponent::handleCameraVel);
+        on<Vector3>("camera",         "dir",      this, &MainComponent::handleCameraDir);
+        on<Vector3>("camera",         "up",       this, &MainComponent::handleCameraUp);
+        on<Vector3>("camera",         0,          this, &MainComponent::ignoreVector);
+        
+        //Objects which don't move, only their positions are used
+        on<Vector3>("river",          "pos",      this, &MainComponent::handleWaterPos);
+        on<Vector3>("waterfall",      "pos",      this, &MainComponent::handleWaterPos);
+        on<Vector3>("smallwaterfall", "pos",      this, &MainComponent::handleWaterPos);
+        on<Vector3>("smallhouse",     "pos",      this, &MainComponent::handleSmallHousePos);
+        on<Vector3>("largehouse",     "pos",      this, &MainComponent::handleLargeHousePos);
+        on<Vector3>("underbridge",    "pos",      this, &MainComponent::handleUnderBridgePos);
+        on<Vector3>("river",          0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("waterfall",      0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("smallwaterfall", 0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("smallhouse",     0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("largehouse",     0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("underbridge",    0,          this, &MainComponent::ignoreVector);
+        on<Vector3>("overbridge",     0,          this, &MainComponent::ignoreVector);
+        
+        //There is only one soldier, bullet and grenade so their ids are ignored
+        on<Vector3>("soldier",        "pos",      this, &MainComponent::handlePlayerPos);
+        on<Vector3>("soldier",        "vel",      this, &MainComponent::handlePlayerVel);
+        on<Vector3>("soldier",        "dir",      this, &MainComponent::handlePlayerDir);
+        on<Vector3>("bullet",         "pos",      this, &MainComponent::handlePlayerPos);
+        on<Vector3>("bullet",         "vel",      this, &MainComponent::handlePlayerVel);
+        on<Vector3>("bullet",         "dir",      this, &MainComponent::handlePlayerDir);
+        on<Vector3>("grenade",        "pos",      this, &MainComponent::handlePlayerPos);
+        on<Vector3>("grenade",        "vel",      this, &MainComponent::handlePlayerVel);
+        on<Vector3>("grenade",        "dir",      this, &MainComponent::handlePlayerDir);
+        on<Vector3>(0,                "pos",      this, &MainComponent::handleObjectPos);
+        on<Vector3>(0,                "vel",      this, &MainComponent::handleObjectVel);
+        on<Vector3>(0,                "dir",      this, &MainComponent::handleObjectDir);
+        
+        on<Collision>("soldier",      0,          this, &MainComponent::handleFootstep);
+        on<Collision>("bullet",       0,          this, &MainComponent::handleBulletImpact);
+        on<Collision>("grenade",      0,          this, &MainComponent::handleBulletImpact);
+        on<Collision>(0,              0,          this, &MainComponent::handleObjectCollision);
+        
+        on<String>("soldier",         "water",    this, &MainComponent::handleSoldierWater);
+        on<String>("soldier",         "gun",      this, &MainComponent::handleSoldierGun);
+        on<bool>("soldier",           "water",    this, &MainComponent::handleSoldierInWater);
+        on<int>("soldier",            "gun",      this, &MainComponent::handleSoldierWeapon);
+        on<double>("grenade",         "explode",  this, &MainComponent::handleGrenadeExplode);
+    }
+    
 	/** Vectors from the game for 3D positionable objects.
 	 Some objects which don't move will only be reported at the start of the game.
-	 Other objects (like the soldier and camera) will move. 
+	 Other objects (like the soldier and camera) will move. Each object and
+	 parameter is registered to one of the handle functions below in registerHandlers().
 	 
 	 @param name	One of the following:
 					 - @c camera:					the camera and listener
@@ -517,138 +758,128 @@ public:
 	 @param gameObjectInstanceID
 					needed for many of these objects
 					<br><br>
-	 @param param	One of the following:
+	 The parameter is one of the following:
 					- @c pos: position in m
 					- @c vel: velocity in m/s
 					- @c dir: direction facing
 					- @c up:  where is the up direction (@e name @c camera only)
 					<br><br>
 	 @param vector	Stucture containing the vector data.
-					- @c x: @e vector->x
-					- @c y: @e vector->y
-					- @c z: @e vector->z
+					- @c x: @e vector.x
+					- @c y: @e vector.y
+					- @c z: @e vector.z
 	 */
-
-	void handleVector(String const& name, int gameObjectInstanceID, String const& param, const Vector3* vector)
-	{
-        String uniqueString;
-        if (name == Strings::Camera)
-        {
-            handleCameraVector (param, vector);
-        }
-        else if (name == Strings::ObjectWaterfall || name == Strings::ObjectSmallWaterfall || name == Strings::ObjectSmallHouse || name == Strings::ObjectUnderBridge || name == Strings::ObjectOverBridge || name == Strings::ObjectLargeHouse ||  name == Strings::ObjectRiver)
-        {
-            //Sets vector data for objects which do not move
-            handleStaticVector(name, gameObjectInstanceID, param, vector);
-        }
-        
-        else
-        {
-            uniqueString = makeUniqueString(name, gameObjectInstanceID);
-            
-            if (name == Strings::Soldier || name == Strings::Bullet || name == Strings::Grenade)
-            {
-                uniqueString = name;
-            }
+    void handleObjectPos(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        VectorData objectData = getObject(name, gameObjectInstanceID);
         
-            if (param == Strings::VectorPosition) {
-                //Updates objects dictionary with new position for item
-                objects.get(uniqueString)->setVectors(vector, nullptr, nullptr);
-            }
-            if (param == Strings::VectorVelocity) {
-                //Updates objects dictionary with new velocity for item
-                objects.get(uniqueString)->setVectors(nullptr, vector, nullptr);
-            }
-            if (param == Strings::VectorDirection) {
-                //Updates objects dictionary with new direction for item
-                objects.get(uniqueString)->setVectors(nullptr, nullptr, vector);
-            }    
-
-        }        
+        //Updates objects with new position for item
+        if (objectData.isValid())
+            objectData.setVectors(&vector, nullptr, nullptr);
     }
     
-    void handleCameraVector (String const& param, const Vector3* vector)
+    void handleObjectVel(String const& name, int gameObjectInstanceID, Vector3 const& vector)
     {
-        // the camera and listener
+        VectorData objectData = getObject(name, gameObjectInstanceID);
         
-        if(param == Strings::VectorPosition) {
-            ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
-                                                          vector, 0, 0, 0));
-        }
-        else if(param == Strings::VectorVelocity) {
-            ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
-                                                          0, vector, 0, 0));
-        }
-        else if(param == Strings::VectorDirection) {
-            ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
-                                                          0, 0, vector, 0));
-        }
-        else if(param == Strings::VectorUp) {
-            ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
-                                                          0, 0, 0, vector));
-        }
+        //Updates objects with new velocity for item
+        if (objectData.isValid())
+            objectData.setVectors(nullptr, &vector, nullptr);
+    }
+    
+    void handleObjectDir(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        VectorData objectData = getObject(name, gameObjectInstanceID);
         
+        //Updates objects with new direction for item
+        if (objectData.isValid())
+            objectData.setVectors(nullptr, nullptr, &vector);
     }
     
-    void handleStaticVector (String const& name, int gameObjectInstanceID, String const& param, const Vector3* vector)
+    //The soldier, bullet and grenade are stored with an id of 0
+    void handlePlayerPos(String const& name, int, Vector3 const& vector)   { handleObjectPos(name, 0, vector); }
+    void handlePlayerVel(String const& name, int, Vector3 const& vector)   { handleObjectVel(name, 0, vector); }
+    void handlePlayerDir(String const& name, int, Vector3 const& vector)   { handleObjectDir(name, 0, vector); }
+    
+    //Velocities and directions of the static objects
+    void ignoreVector(String const&, int, Vector3 const&) {}
+    
+    // the camera and listener
+    void handleCameraPos(String const&, int, Vector3 const& vector)
     {
-        String uniqueString = makeUniqueString(name, gameObjectInstanceID);
-        //Only sets position as objects do not move, therefore no velocity or direction
-        if (param == Strings::VectorPosition)
+        listenerPos = vector;
+        voiceBudget.setListener(vector);
+        ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
+                                                      &vector, 0, 0, 0));
+    }
+    
+    void handleCameraVel(String const&, int, Vector3 const& vector)
+    {
+        ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
+                                                      0, &vector, 0, 0));
+    }
+    
+    void handleCameraDir(String const&, int, Vector3 const& vector)
+    {
+        ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
+                                                      0, 0, &vector, 0));
+    }
+    
+    void handleCameraUp(String const&, int, Vector3 const& vector)
+    {
+        ERRCHECK(eventsystem->set3DListenerAttributes(FMOD_MAIN_LISTENER,
+                                                      0, 0, 0, &vector));
+    }
+    
+    //Only positions arrive for the static objects as they do not move, therefore no velocity or direction
+    void handleWaterPos(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        VectorData objectData = getObject(name, gameObjectInstanceID);
+        if (objectData.isValid())
         {
-            if (name == Strings::ObjectRiver || name == Strings::ObjectSmallWaterfall || name == Strings::ObjectWaterfall)
-            {
-                VectorData* objectData = objects.get(uniqueString);
-                if (objectData)
-                {
-                    objectData->setVectors(vector, nullptr, nullptr);
-                }
-                startLooping (name, gameObjectInstanceID);
-            }
-            
-            if (name == Strings::ObjectSmallHouse)
-            {
-                ERRCHECK(smallHouseReverb->set3DAttributes(vector, 4, 6));
-            }
-            
-            if (name == Strings::ObjectLargeHouse)
-            {
-                ERRCHECK(largeHouseReverb->set3DAttributes(vector, 9, 10.5));
-            }
-            
-            if (name == Strings::ObjectUnderBridge)
-            {
-                
-                //Checks to see if underBridge1 has been set, if it has, set underbridge 2 with incoming position
-                float minCheck;
-                ERRCHECK(underBridgeReverb1->get3DAttributes(0, &minCheck, 0));
-                if(minCheck == 0)
-                {
-                    // set the position properties in game world units (metres here)                    
-                    ERRCHECK(underBridgeReverb1->set3DAttributes(vector, 10, 16));
-                }
-                else
-                {
-                    ERRCHECK(underBridgeReverb2->set3DAttributes(vector, 10, 16));
-                }
-                
-            }
+            objectData.setVectors(&vector, nullptr, nullptr);
         }
+        startLooping (name, gameObjectInstanceID);
+    }
+    
+    // set the position properties in game world units (metres here)
+    void handleSmallHousePos(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        setReverbZone(name, gameObjectInstanceID, Reverbs::SmallHouse, vector, 4, 6);
+    }
+    
+    void handleLargeHousePos(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        setReverbZone(name, gameObjectInstanceID, Reverbs::LargeHouse, vector, 9, 10.5);
+    }
+    
+    void handleUnderBridgePos(String const& name, int gameObjectInstanceID, Vector3 const& vector)
+    {
+        //Every part under the bridge has its own zone, however many there are
+        setReverbZone(name, gameObjectInstanceID, Reverbs::UnderBridge, vector, 10, 16);
+    }
+    
+    //Places the reverb zone of an object, keyed by its handle so it's removed with the object
+    void setReverbZone(String const& name, int gameObjectInstanceID, Reverbs::Preset preset,
+                       Vector3 const& vector, float minDistance, float maxDistance)
+    {
+        if (!getObject(name, gameObjectInstanceID).isValid())
+            createObject(name, gameObjectInstanceID);
+        
+        reverbZones.setZone(objectKeys.find(name, gameObjectInstanceID), preset, vector, minDistance, maxDistance);
     }
 
     
     void startLooping (String const& name, int gameObjectInstanceID)
     {
-        String uniqueString = makeUniqueString(name, gameObjectInstanceID);
-        
         name == Strings::ObjectRiver ? (Globals::riverCounter++) : (Globals::riverCounter);
         
         if (name == Strings::ObjectWaterfall || name == Strings::ObjectSmallWaterfall || name == Strings::ObjectRiver)
         {
-            VectorData* waterData = objects.get(uniqueString);
-            if(waterData)
+            VectorData waterData = getObject(name, gameObjectInstanceID);
+            if(waterData.isValid())
             {
-                waterData->stopEvents();
+                waterData.stopEvents();
                 
                 String waterString;
                 //Allows different sounds to be used for each river section, stream at the top, bigger river under the bridge and by dam
@@ -663,23 +894,18 @@ public:
                                                FMOD_EVENT_DEFAULT, 
                                                &event));
                 
-                waterData->addEvent(event);
+                waterData.addLoopingEvent(event);
                 ERRCHECK(event->start());
             }
         }
     }
     
-	/** String type messages from the game (various).
+	/** String type messages from the game (various), @e soldier.water and @e soldier.gun.
 	 
-	 @param name		One of the following:
-						- @c soldier
+	 @param name		Always @c soldier
 						<br><br>
 	 @param gameObjectInstanceID	Not really needed here.
 						<br><br>
-	 @param param		One of the following:
-						- @c water: when name is "soldier"
-						- @c gun: when name is "soldier"
-						<br><br>
 	 @param content		One of the following:
 						<br><br>
 						For @e soldier.water <br><br><ul>
@@ -692,206 +918,136 @@ public:
 						<li>@c reload:		the gun is being reloaded</li>
 						</ul>
 	 */
-	void handleString(String const& name, int gameObjectInstanceID, String const& param, String const& content)
+	void handleSoldierWater(String const& name, int gameObjectInstanceID, String const& content)
 	{
-        if (name == Strings::Soldier)
+        VectorData soldierData = getObject(Strings::Soldier);
+        Event* event = soldierData.isValid() ? eventTable.getEvent(Sounds::WaterSounds, eventTable.findKey(Sounds::WaterSounds, content)) : nullptr;
+        if(event)
         {
-            //If soldier
-            if (param == Strings::Water)
-            {
-                String waterString = Strings::WaterLocation + content;
-                    VectorData* soldierData = objects.get(Strings::Soldier);
-                    if(soldierData)
-                    {
-                        //Soldier hits water/jumps while in water
-                        Event* event;
-                        
-                        ERRCHECK(eventsystem->getEvent(waterString.toUTF8(),
-                                                       FMOD_EVENT_DEFAULT, 
-                                                       &event));                        
-                        soldierData->addEvent(event);
-                        ERRCHECK(event->start());
-                    }
+            //Soldier hits water/jumps while in water
+            voiceBudget.start(soldierData, event, Sounds::WaterSounds);
+        }
+	}
+	
+	void handleSoldierGun(String const& name, int gameObjectInstanceID, String const& content)
+	{
+        //Checks if the grenadelauncher is in use, changes between grenadelauncher reload/firing and machine gun
+        const Sounds::Category weapon = Globals::grenadeLauncher ? Sounds::GrenadeLauncherSounds : Sounds::GunSounds;
+        
+        VectorData gunData = getObject(Strings::Soldier);
+        Event* event = gunData.isValid() ? eventTable.getEvent(weapon, eventTable.findKey(weapon, content)) : nullptr;
+        
+        if(event)
+        {
+            //Gun Shot
+            voiceBudget.start(gunData, event, weapon);
             
-            }
-            else if (param == Strings::Gun)
+            if (!Globals::grenadeLauncher)
             {
-                String gunString = Strings::GunsLocation;
-                
-                //Checks if the grenadelauncher is in use, changes between grenadelauncher reload/firing and machine gun
-                //Machine gun reloading has a longer animation so a longer version of the reloading sound was used 
-                if (Globals::grenadeLauncher)
-                    gunString = gunString + "grenade";
-                else
-                    gunString = gunString + "gun";
-                
-                gunString = gunString + content;
-                
-                VectorData* gunData = objects.get(Strings::Soldier);
-                
-                if(gunData)
-                {
-                    //Gun Shot
-                    Event* event;
-                    
-                    
-                    
-                    ERRCHECK(eventsystem->getEvent(gunString.toUTF8(),
-                                                   FMOD_EVENT_DEFAULT, 
-                                                   &event));
-                                      
-                    gunData->addEvent(event);
-                    ERRCHECK(event->start());
-                    
-                    if (!Globals::grenadeLauncher)
-                    {
-                        //Checks to make sure gun is in use, grenades have their own bird flying event
-                        //If a certain amount of time has past since the last gun shot triggers the sound of birds flying away
-                        if (Globals::birdCounter > birdCounterTrigger)
-                        {
-                            gunData->addEvent(birdsFlying);
-                            ERRCHECK(birdsFlying->start());
-                        }
-                        //Sets the bird counter to 0 every time the gun is fired. Makes sure the birds only return when the gun hasn't been fired for a while
-                        Globals::birdCounter = 0;
-                    }
-                }
-                
-                
-                else if (content == Strings::GunEmpty)
+                //Checks to make sure gun is in use, grenades have their own bird flying event
+                //If a certain amount of time has past since the last gun shot triggers the sound of birds flying away
+                if (Globals::birdCounter > birdCounterTrigger)
                 {
-                    //Ammo is unlimited, should never be called, included for future
+                    gunData.addEvent(birdsFlying);
+                    ERRCHECK(birdsFlying->start());
                 }
+                //Sets the bird counter to 0 every time the gun is fired. Makes sure the birds only return when the gun hasn't been fired for a while
+                Globals::birdCounter = 0;
             }
         }
+        
+        
+        else if (content == Strings::GunEmpty)
+        {
+            //Ammo is unlimited, should never be called, included for future
+        }
 	}
 	
 	/** Boolean (on/off) messages from the game.
 	 
-	 @param name		One of the following:
-						- @c soldier
+	 Only @e soldier.water is sent.
+	 
+	 @param name		Always @c soldier
 						<br><br>
 	 @param gameObjectInstanceID	Not really needed here.
 						<br><br>
-	 @param param		One of the following:
-						- @c water: when @e name is "soldier"
-						<br><br>
 	 @param flag		One of the following:
-						- when @e param is @c "water" @c true means the soldier is moving in the water
-						- when @e param is @c "water" @c false means the soldier stopped moving in the water
+						- @c true means the soldier is moving in the water
+						- @c false means the soldier stopped moving in the water
 	 
 	 */
-	void handleBool(String const& name, int gameObjectInstanceID, String const& param, bool flag)
+	void handleSoldierInWater(String const& name, int gameObjectInstanceID, bool const& flag)
 	{
-        if (name == Strings::Soldier)
-        {
-            //If soldier
-            if (param == Strings::Water)
-            {
-                //Soldier in water
-                Globals::inWater = flag;
-            }
-        }
+        //Soldier in water
+        Globals::inWater = flag;
 	}
 	
 	/** Integer messages from the game.
 	 
-	 @param name		One of the following:
-						- @c soldier
+	 Only @e soldier.gun is sent.
+	 
+	 @param name		Always @c soldier
 						<br><br>
 	 @param gameObjectInstanceID	
 						Not really needed here.
 						<br><br>
-	 @param param		One of the following:
-						- @c gun: when @e name is "soldier" the value is the weapon selected 0=gun, 1=grenade
-						<br><br>
-	 @param value		The values described under the @e param section above.
+	 @param value		The weapon selected 0=gun, 1=grenade
 	 */
-	void handleInt(String const& name, int gameObjectInstanceID, String const& param, int value)
+	void handleSoldierWeapon(String const& name, int gameObjectInstanceID, int const& value)
 	{   
-        if (name == Strings::Soldier)
-        {
-            //If soldier
-            if (param == Strings::Gun)
-            {
-                //True if using grenadeLauncher false if using the gun
-                Globals::grenadeLauncher = value;
-            }
-        }
+        //True if using grenadeLauncher false if using the gun
+        Globals::grenadeLauncher = value;
 	}
 	
 	/** "Real" messages from the game i.e., continuous controls.
 	 
-	 @param name		One of the following:
-						- @c grenade
+	 Only @e grenade.explode is sent.
+	 
+	 @param name		Always @c grenade
 						<br><br>
 	 @param gameObjectInstanceID	
 						Not really needed here.
 						<br><br>
-	 @param param		One of the following:
-						- @c explode: when @e name is "grenade" the power of the grenade
-									  that's just about to explode (always 320 in this version)
-						<br><br>
-	 @param value		The values described under the @e param section above.
+	 @param value		The power of the grenade that's just about to explode (always 320 in this version)
 	 */
-	void handleReal(String const& name, int gameObjectInstanceID, String const& param, double value)
+	void handleGrenadeExplode(String const& name, int gameObjectInstanceID, double const& value)
 	{
-        if (name == Strings::Grenade)
-        {
-            if (param == Strings::GrenadeExplode)
+        VectorData grenadeData = getObject(Strings::Grenade);
+        //Play explosion sound
+        if(grenadeData.isValid())
+        {                    
+            Event* event = eventTable.getEvent(Sounds::Explosions, Sounds::Explode);
+            Event* ring;
+            
+            if (event)
+                voiceBudget.start(grenadeData, event, Sounds::Explosions);
+            
+            //If a certain amount of time has past since the last gun shot triggers the sound of birds flying away
+            if (Globals::birdCounter > birdCounterTrigger)
             {
-                VectorData* grenadeData = objects.get(Strings::Grenade);
-                //Play explosion sound
-                if(grenadeData)
-                {                    
-                    Event* event;
-                    Event* ring;
-                    String grenadeString = Strings::GunsLocation+"explode";
-                    
-                    ERRCHECK(eventsystem->getEvent(grenadeString.toUTF8(),
-                                                   FMOD_EVENT_DEFAULT, 
-                                                   &event));
-                    grenadeData->addEvent(event);
-                    ERRCHECK(event->start());
-                    
-                    //If a certain amount of time has past since the last gun shot triggers the sound of birds flying away
-                    if (Globals::birdCounter > birdCounterTrigger)
-                    {
-                        //Placed in the grenadeExplode event so the sound waits till the grenade has exploded instead of when it has been fired
-                        //Position the birds flying sound on the soldier so it is always distant and away from the soldier. Positioning the sound on the grenade meant that the birds could be triggered too close to the listener
-                        VectorData* soldierData = objects.get(Strings::Soldier);
-                        
-                        soldierData->addEvent(birdsFlying);
-                        ERRCHECK(birdsFlying->start());
-                    }
-                    //Sets the bird counter to 0 every time the gun is fired. Makes sure the birds only return when the gun hasn't been fired for a while
-                    Globals::birdCounter = 0;
-                    
-                    //Adds a loud ringing sound depending on how close the explosion was. Being able to trigger a global heavy low pass filter would complete this effect
-                    grenadeString = grenadeString+"Ring";
-                    
-                    ERRCHECK(eventsystem->getEvent(grenadeString.toUTF8(),
-                                                   FMOD_EVENT_DEFAULT, 
-                                                   &ring));
-                    
-                    VectorData* soldierData = objects.get(Strings::Soldier);
-                    
-                    if (soldierData) {
-                        soldierData->addEvent(ring);
-                        
-                        EventParameter* param;
-                        ERRCHECK(ring->getParameter(Strings::ExplodeDistance, &param));
-                        //Work out the distance from the soldier, if the soldier is facing the way which he didn't start then the number will be a minus, therefore abs is required, so the number can use the same parameter
-                        float distance = abs(grenadeData->getPos()->z - soldierData->getPos()->z);
-                        
-                        ERRCHECK(param->setValue(distance));
-                        //Comment out the line below to turn the ringing off for collision testing purposes
-                        ERRCHECK(ring->start());
-                        
-                    }                    
-                }
+                //Placed in the grenadeExplode event so the sound waits till the grenade has exploded instead of when it has been fired
+                //Position the birds flying sound on the soldier so it is always distant and away from the soldier. Positioning the sound on the grenade meant that the birds could be triggered too close to the listener
+                VectorData soldierData = getObject(Strings::Soldier);
                 
+                soldierData.addEvent(birdsFlying);
+                ERRCHECK(birdsFlying->start());
             }
+            //Sets the bird counter to 0 every time the gun is fired. Makes sure the birds only return when the gun hasn't been fired for a while
+            Globals::birdCounter = 0;
+            
+            //Adds a loud ringing sound depending on how close the explosion was. Being able to trigger a global heavy low pass filter would complete this effect
+            VectorData soldierData = getObject(Strings::Soldier);
+            ring = soldierData.isValid() ? eventTable.getEvent(Sounds::Explosions, Sounds::ExplodeRing) : nullptr;
+            
+            if (ring) {
+                //Work out the distance from the soldier, if the soldier is facing the way which he didn't start then the number will be a minus, therefore abs is required, so the number can use the same parameter
+                float distance = abs(grenadeData.getPos()->z - soldierData.getPos()->z);
+                
+                objectStore.getParameters().setValue(ring, Parameters::ExplodeDistance, distance);
+                //Comment out the line below to turn the ringing off for collision testing purposes
+                voiceBudget.start(soldierData, ring, Sounds::Explosions);
+                
+            }                    
         }
 	}
 		
@@ -946,91 +1102,62 @@ public:
 						<br><br>
 						The impact positions for bullet and grenades will have been reported just before 
 						the collision/explosion via the "bullet" or "grenade" position (@c pos) vector - 
-						see handleVector().
+						see handleObjectPos().
 	 */
-	void handleHit(String const& name, int gameObjectInstanceID, Collision const& collision)
+	void handleFootstep(String const& name, int gameObjectInstanceID, Collision const& collision)
 	{
-        if (name == Strings::Soldier) {
-            //0.4 is the general walking velocity, 1 is running
-            if (collision.velocity == 1)
-                Globals::running = true;
-            else
-                Globals::running = false;
-            
-            VectorData* soldierData = objects.get(Strings::Soldier);
-            if(soldierData)
-            {
-                String footstepString;
-                
-                if (Globals::inWater)
-                    footstepString = Strings::FootstepLocation+String("water");
-                else
-                    footstepString = Strings::FootstepLocation+collision.otherName;
-                
-                Event* event;
-                
-                ERRCHECK(eventsystem->getEvent(footstepString.toUTF8(),
-                                               FMOD_EVENT_DEFAULT, 
-                                               &event));
-                
-                EventParameter* param = nullptr;
-                //Not error checked as some footsteps don't have a velocity parameter
-                event->getParameter(Strings::Velocity, &param);
-                
-                if (param != nullptr)
-                    ERRCHECK(param->setValue(collision.velocity));
-                
-                soldierData->addEvent(event);
-                ERRCHECK(event->start());            
-            }
-        }
+        //0.4 is the general walking velocity, 1 is running
+        if (collision.velocity == 1)
+            Globals::running = true;
+        else
+            Globals::running = false;
         
-        else if (name == Strings::Bullet || name == Strings::Grenade)
+        VectorData soldierData = getObject(Strings::Soldier);
+        const int surface = Globals::inWater ? (int)Sounds::Water : eventTable.findKey(Sounds::Footsteps, collision.otherName);
+        Event* event = soldierData.isValid() ? eventTable.getEvent(Sounds::Footsteps, surface) : nullptr;
+        
+        if(event)
         {
-            String bulletString = Strings::GunsLocation + Strings::Bullet + "/" + collision.otherName;
+            //Some footsteps don't have a velocity parameter, those are skipped
+            objectStore.getParameters().setValue(event, Parameters::Velocity, collision.velocity);
             
-            VectorData* bulletData = objects.get(Strings::Bullet);
-            if(bulletData)
-            {                    
-                Event* event;
-                
-                ERRCHECK(eventsystem->getEvent(bulletString.toUTF8(),
-                                               FMOD_EVENT_DEFAULT, 
-                                               &event));
-                
-                bulletData->addEvent(event);
-                ERRCHECK(event->start());
-            }            
+            voiceBudget.start(soldierData, event, Sounds::Footsteps, collision.velocity);
         }
+	}
+    
+	void handleBulletImpact(String const& name, int gameObjectInstanceID, Collision const& collision)
+	{
+        VectorData bulletData = getObject(Strings::Bullet);
+        Event* event = bulletData.isValid() ? eventTable.getEvent(Sounds::BulletImpacts, eventTable.findKey(Sounds::BulletImpacts, collision.otherName)) : nullptr;
         
-        else
+        if(event)
+        {                    
+            //The velocity falls with the distance the bullet was fired from
+            voiceBudget.start(bulletData, event, Sounds::BulletImpacts, collision.velocity);
+        }            
+	}
+    
+	void handleObjectCollision(String const& name, int gameObjectInstanceID, Collision const& collision)
+	{
+        if (collision.velocity > 0)
         {
-            if (collision.velocity > 0)
+            const int handle = objectKeys.find(name, gameObjectInstanceID);
+            VectorData collisionObject = getObject(name, gameObjectInstanceID);
+            
+            //Only the first and the hardest of a burst of hits on the same surface play
+            if (!collisionObject.isValid()
+                || !collisionCoalescer.shouldPlay(handle, eventTable.findKey(Sounds::BulletImpacts, collision.otherName), collision.velocity))
+                return;
+            
+            Event* event = eventTable.getEvent(Sounds::Collisions, eventTable.findKey(Sounds::Collisions, name));
+            
+            if (event)
             {
-                String uniqueString = makeUniqueString(name, gameObjectInstanceID);
-                
-                String collisionString = Strings::CollisionsLocation + name;
-                VectorData* collisionObject = objects.get(uniqueString);
+                objectStore.getParameters().setValue(event, Parameters::Velocity, collision.velocity);
                 
-                if (collisionObject)
-                {
-                    Event* event;
-                    
-                    ERRCHECK(eventsystem->getEvent(collisionString.toUTF8(),
-                                                   FMOD_EVENT_DEFAULT, 
-                                                   &event));
-                    
-                    EventParameter* param;
-                    ERRCHECK(event->getParameter(Strings::Velocity, &param));
-                    
-                    ERRCHECK(param->setValue(collision.velocity));
-                    
-                    collisionObject->addEvent(event);
-                    ERRCHECK(event->start());
-                }
+                voiceBudget.start(collisionObject, event, Sounds::Collisions, collision.velocity);
             }
         }
-        
 	}
 };
 
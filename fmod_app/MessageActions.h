@@ -0,0 +1,169 @@
+#ifndef MESSAGEACTIONS_H
+#define MESSAGEACTIONS_H
+
+#include <juce/juce.h>
+
+/** Maps a message's type, object and parameter to an action number, from a table written once.
+
+ GameEngineServer keeps the handlers registered with GameEngineServer::on() in
+ one of these, the action being 1 + the handler's index, so a message finds its
+ handler without its name and parameter being compared against each
+ registration in turn. Several entries may share an action:
+ @code
+ enum MyAction { NoAction = MessageActionTable::noAction, CameraPosition, Footstep, BulletImpact, Collision };
+
+ static const MessageActionTable::Entry myEntries[] =
+ {
+     { CameraPosition,	'v', "camera",	"pos" },
+     { Footstep,		'c', "soldier",	0 },
+     { BulletImpact,	'c', "bullet",	0 },
+     { BulletImpact,	'c', "grenade",	0 },
+     { Collision,		'c', 0,			0 }
+ };
+
+ static const MessageActionTable myActions(myEntries, numElementsInArray(myEntries));
+ @endcode
+
+ A 0 object or parameter matches any. The most specific entry wins: the exact
+ object and parameter, then the object with any parameter, then any object
+ with the parameter and finally any object with any parameter.
+
+ The entries are placed in a hash table with no collisions (the hash is
+ reseeded, and the table grown, until each entry has its own slot) so finding
+ an entry is one hash and one string comparison. GameEngineServer only finds
+ a handler the first time each name arrives with each type and keeps it with
+ the name, so from then on it costs nothing per message.
+ */
+class MessageActionTable
+{
+public:
+	enum { noAction = 0 };
+
+	struct Entry
+	{
+		int action;
+		char type;				///< the lower case message type, e.g., 'v'
+		const char* object;		///< 0 for any object
+		const char* param;		///< 0 for any parameter
+	};
+
+	MessageActionTable(const Entry* tableEntries, int numTableEntries)
+	:	entries(tableEntries),
+		numEntries(numTableEntries),
+		seed(0),
+		mask(0)
+	{
+		build();
+	}
+
+	/** Returns the action for a message, or noAction if there's no entry for it. */
+	int find(char type, String const& object, String const& param) const
+	{
+		const char* objectText = (const char*)object.toUTF8();
+		const char* paramText = (const char*)param.toUTF8();
+
+		const Entry* entry = findEntry(type, objectText, paramText);
+
+		if(entry == 0)
+			entry = findEntry(type, objectText, 0);
+
+		if(entry == 0)
+			entry = findEntry(type, 0, paramText);
+
+		if(entry == 0)
+			entry = findEntry(type, 0, 0);
+
+		return entry != 0 ? entry->action : (int)noAction;
+	}
+
+private:
+	const Entry* entries;
+	const int numEntries;
+	uint32 seed, mask;
+	HeapBlock<const Entry*> slots;
+
+	static uint32 hash(uint32 seed, char type, const char* object, const char* param)
+	{
+		// FNV-1a, a missing object or parameter hashes differently from an empty one
+		uint32 h = 2166136261u ^ seed;
+
+		h = (h ^ (uint8)type) * 16777619u;
+		h = (h ^ (object != 0 ? 1u : 0u)) * 16777619u;
+
+		for(const char* c = object; c != 0 && *c != 0; c++)
+			h = (h ^ (uint8)*c) * 16777619u;
+
+		h = (h ^ (param != 0 ? 2u : 0u)) * 16777619u;
+
+		for(const char* c = param; c != 0 && *c != 0; c++)
+			h = (h ^ (uint8)*c) * 16777619u;
+
+		return h ^ (h >> 15);
+	}
+
+	static bool matches(const char* a, const char* b)
+	{
+		return a == 0 ? b == 0 : (b != 0 && strcmp(a, b) == 0);
+	}
+
+	const Entry* findEntry(char type, const char* object, const char* param) const
+	{
+		const Entry* entry = slots[hash(seed, type, object, param) & mask];
+
+		if(entry != 0 && entry->type == type && matches(entry->object, object) && matches(entry->param, param))
+			return entry;
+
+		return 0;
+	}
+
+	void build()
+	{
+		const int maxSeeds = 64;
+
+		int size = 4;
+
+		while(size < numEntries * 2)
+			size *= 2;
+
+		for(;; size *= 2)
+		{
+			mask = (uint32)size - 1;
+
+			for(seed = 0; seed < (uint32)maxSeeds; seed++)
+			{
+				if(tryToPlaceEntries(size))
+					return;
+			}
+		}
+	}
+
+	bool tryToPlaceEntries(int size)
+	{
+		slots.calloc(size);
+
+		for(int i = 0; i < numEntries; i++)
+		{
+			const Entry& entry = entries[i];
+			const Entry*& slot = slots[hash(seed, entry.type, entry.object, entry.param) & mask];
+
+			// a duplicate entry would never place, the first one wins
+			if(slot != 0 && slot->type == entry.type && matches(slot->object, entry.object) && matches(slot->param, entry.param))
+			{
+				jassertfalse;
+				continue;
+			}
+
+			if(slot != 0)
+				return false;
+
+			slot = &entry;
+		}
+
+		return true;
+	}
+
+	MessageActionTable(const MessageActionTable&);
+	MessageActionTable& operator=(const MessageActionTable&);
+};
+
+#endif // MESSAGEACTIONS_H
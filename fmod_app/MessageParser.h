@@ -0,0 +1,294 @@
+#ifndef MESSAGEPARSER_H
+#define MESSAGEPARSER_H
+
+#include <juce/juce.h>
+
+/** A run of characters inside a MessageParser's buffer, in the style of a string_view.
+ Nothing is copied so a span is only valid until more data is written to the parser. */
+class TokenSpan
+{
+public:
+	TokenSpan()
+	:	text(0),
+		length(0)
+	{
+	}
+
+	TokenSpan(const char* spanText, int spanLength)
+	:	text(spanText),
+		length(spanLength)
+	{
+	}
+
+	bool isEmpty() const { return length == 0; }
+
+	/** Returns a character, or 0 if the index is out of range. */
+	char operator[](int index) const { return isPositiveAndBelow(index, length) ? text[index] : 0; }
+
+	/** Compares with a null terminated string. */
+	bool equals(const char* other) const
+	{
+		if(length == 0)
+			return other[0] == 0;		// text may be null
+
+		return strncmp(text, other, length) == 0 && other[length] == 0;
+	}
+
+	/** Removes a quote character from the start and end of the span if present. */
+	TokenSpan unquoted() const
+	{
+		TokenSpan result(*this);
+
+		if(result.length > 0 && (result.text[0] == '"' || result.text[0] == '\''))
+		{
+			result.text++;
+			result.length--;
+		}
+
+		if(result.length > 0 && (result.text[result.length - 1] == '"' || result.text[result.length - 1] == '\''))
+			result.length--;
+
+		return result;
+	}
+
+	int getIntValue() const
+	{
+		int i = 0;
+		bool negative = false;
+
+		if(i < length && (text[i] == '-' || text[i] == '+'))
+			negative = text[i++] == '-';
+
+		int value = 0;
+
+		while(i < length && text[i] >= '0' && text[i] <= '9')
+			value = value * 10 + (text[i++] - '0');
+
+		return negative ? -value : value;
+	}
+
+	double getDoubleValue() const
+	{
+		if(length == 0)
+			return 0;
+
+		// strtod needs a terminator, copy to the stack rather than the heap
+		char number[64];
+		const int numChars = jmin(length, (int)sizeof(number) - 1);
+		memcpy(number, text, numChars);
+		number[numChars] = 0;
+		return strtod(number, 0);
+	}
+
+	float getFloatValue() const { return (float)getDoubleValue(); }
+
+	/** Makes a String copy of the span (this allocates, so keep it off the hot path). */
+	String toString() const { return String(text, length); }
+
+	const char* text;
+	int length;
+};
+
+/** An incremental parser for the data arriving on a connection.
+
+ Data is read from the socket straight into a ring buffer (see getWriteBuffer())
+ and complete lines or frames are then taken from the front. A line or frame
+ split across two reads simply waits in the buffer until the rest arrives.
+
+ The returned spans point into the ring buffer, so nothing is allocated once
+ the parser has been constructed. The only copy made is when a line wraps
+ around the end of the ring, in which case it is joined in a scratch buffer. */
+class MessageParser
+{
+public:
+	/** @param bufferSize	The largest line or frame which can be parsed, rounded up to a power of two. */
+	MessageParser(int bufferSize = 32768)
+	:	capacity(nextPowerOfTwo(bufferSize)),
+		ring(capacity),
+		scratch(capacity),
+		readPos(0),
+		numReady(0),
+		numScanned(0),
+		skipping(false)
+	{
+	}
+
+	/** Discards any buffered data, e.g., when a new connection is made. */
+	void reset()
+	{
+		readPos = numReady = numScanned = 0;
+		skipping = false;
+	}
+
+	/** Discards the buffered data and the rest of the line it belongs to.
+	 Call when the buffer is full without a complete line in it (see isFull()),
+	 so no part of a line too long for the buffer is ever returned. readLine()
+	 drops everything up to and including the next line ending. */
+	void skipLine()
+	{
+		reset();
+		skipping = true;
+	}
+
+	/** Returns the space where the next socket read should be written.
+	 @param numBytesFree	Set to the number of contiguous bytes which can be written,
+							zero if the buffer is full. */
+	char* getWriteBuffer(int& numBytesFree)
+	{
+		if(numReady == 0)
+			readPos = 0; // keep the free space contiguous when possible
+
+		const int writePos = (readPos + numReady) & (capacity - 1);
+
+		if(numReady == capacity)
+			numBytesFree = 0;
+		else if(writePos >= readPos)
+			numBytesFree = capacity - writePos;
+		else
+			numBytesFree = readPos - writePos;
+
+		return ring + writePos;
+	}
+
+	/** Call after writing into the space returned by getWriteBuffer(). */
+	void written(int numBytes)
+	{
+		numReady += numBytes;
+	}
+
+	/** The number of bytes waiting to be parsed. */
+	int getNumBytesReady() const { return numReady; }
+
+	/** True if the buffer is full without a complete line in it. */
+	bool isFull() const { return numReady == capacity; }
+
+	/** Takes the next complete line from the buffer.
+	 The line excludes its line ending. Returns false if no complete line has arrived yet. */
+	bool readLine(TokenSpan& line)
+	{
+		const int mask = capacity - 1;
+
+		// only scan the bytes which haven't been scanned by an earlier call
+		while(numScanned < numReady)
+		{
+			if(ring[(readPos + numScanned) & mask] == '\n')
+			{
+				int lineLength = numScanned;
+
+				if(skipping)
+				{
+					// the end of a line which was too long, carry on with the next one
+					consume(lineLength + 1);
+					skipping = false;
+					continue;
+				}
+
+				const char* text = peek(lineLength);
+
+				consume(lineLength + 1);
+
+				if(lineLength > 0 && text[lineLength - 1] == '\r')
+					lineLength--;
+
+				line = TokenSpan(text, lineLength);
+				return true;
+			}
+
+			numScanned++;
+		}
+
+		// the rest of a line being skipped needn't wait in the buffer
+		if(skipping)
+			consume(numScanned);
+
+		return false;
+	}
+
+	/** Returns the next numBytes bytes as one contiguous block without consuming them.
+	 Returns 0 if that many bytes haven't arrived. */
+	const char* peek(int numBytes)
+	{
+		if(numBytes > numReady)
+			return 0;
+
+		if(readPos + numBytes <= capacity)
+			return ring + readPos;
+
+		// wraps around the end of the ring
+		const int firstPart = capacity - readPos;
+		memcpy(scratch, ring + readPos, firstPart);
+		memcpy(scratch + firstPart, ring, numBytes - firstPart);
+		return scratch;
+	}
+
+	/** Removes bytes from the front of the buffer. */
+	void consume(int numBytes)
+	{
+		numBytes = jmin(numBytes, numReady);
+		readPos = (readPos + numBytes) & (capacity - 1);
+		numReady -= numBytes;
+		numScanned = jmax(0, numScanned - numBytes);
+	}
+
+	/** Splits text at whitespace, keeping quoted strings (including their quotes) as one token.
+	 @return The number of tokens found, which may be more than maxTokens
+			 (although only the first maxTokens are filled in). */
+	static int tokenise(TokenSpan const& text, TokenSpan* tokens, int maxTokens)
+	{
+		int numTokens = 0;
+		int i = 0;
+
+		while(i < text.length)
+		{
+			while(i < text.length && isWhitespace(text.text[i]))
+				i++;
+
+			if(i >= text.length)
+				break;
+
+			const int start = i;
+			char quote = 0;
+
+			while(i < text.length && (quote != 0 || !isWhitespace(text.text[i])))
+			{
+				const char c = text.text[i++];
+
+				if(quote == 0 && (c == '"' || c == '\''))
+					quote = c;
+				else if(c == quote)
+					quote = 0;
+			}
+
+			if(numTokens < maxTokens)
+				tokens[numTokens] = TokenSpan(text.text + start, i - start);
+
+			numTokens++;
+		}
+
+		return numTokens;
+	}
+
+private:
+	int capacity;
+	HeapBlock<char> ring, scratch;
+	int readPos, numReady;
+	int numScanned;		// bytes after readPos already known not to contain a line ending
+	bool skipping;		// dropping the rest of a line too long for the buffer
+
+	static bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+	static int nextPowerOfTwo(int n)
+	{
+		int result = 256;
+
+		while(result < n)
+			result <<= 1;
+
+		return result;
+	}
+
+	MessageParser(const MessageParser&);
+	MessageParser& operator=(const MessageParser&);
+};
+
+#endif // MESSAGEPARSER_H
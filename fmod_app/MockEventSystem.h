@@ -0,0 +1,542 @@
+#ifndef MOCKEVENTSYSTEM_H
+#define MOCKEVENTSYSTEM_H
+
+/** A headless stand-in for the part of the FMOD Ex event API which this app uses.
+
+ headers.h includes this instead of the FMOD headers when FMOD_MOCK is set to
+ 1, so the whole GameEngineServer to MainComponent path can be built and
+ profiled on a machine without FMOD or audio hardware. The classes have the
+ same names and signatures as FMOD's, so none of the calling code changes.
+
+ Nothing is loaded or played. Instead the EventSystem counts the calls made
+ to it (see EventSystem::getMockStats()) and simulates what matters for the
+ app's own bookkeeping:
+ - each event path has a limited number of instances (its max playbacks),
+   and once they're all playing getEvent() steals the one which started first;
+ - a started event plays for a set duration (0 for a looping event which
+   plays until it's stopped), then update() reports it finished through its
+   callback, as FMOD does;
+ - starting more events than the channels passed to init() counts them as
+   virtual voices (they still play, as FMOD's virtual voices would).
+ */
+
+#include <juce/juce.h>
+#include "PointerDictionary.h"
+
+#ifndef F_CALLBACK
+ #define F_CALLBACK
+#endif
+
+typedef enum
+{
+	FMOD_OK,
+	FMOD_ERR_INVALID_PARAM,
+	FMOD_ERR_INVALID_HANDLE,
+	FMOD_ERR_EVENT_FAILED,
+	FMOD_ERR_EVENT_NOTFOUND
+} FMOD_RESULT;
+
+typedef struct
+{
+	float x, y, z;
+} FMOD_VECTOR;
+
+/** Only the fields the mock keeps, the presets fill them with plausible values. */
+typedef struct
+{
+	int Instance;
+	float DecayTime;
+} FMOD_REVERB_PROPERTIES;
+
+#define FMOD_PRESET_OFF				{ 0, 1.0f }
+#define FMOD_PRESET_PLAIN			{ 0, 1.49f }
+#define FMOD_PRESET_ROOM			{ 0, 0.4f }
+#define FMOD_PRESET_LIVINGROOM		{ 0, 0.5f }
+
+typedef unsigned int FMOD_INITFLAGS;
+typedef unsigned int FMOD_EVENT_INITFLAGS;
+typedef unsigned int FMOD_EVENT_MODE;
+typedef unsigned int FMOD_EVENT_STATE;
+
+#define FMOD_INIT_NORMAL			0x00000000
+#define FMOD_EVENT_INIT_NORMAL		0x00000000
+#define FMOD_EVENT_DEFAULT			0x00000000
+#define FMOD_EVENT_STATE_READY		0x00000001
+#define FMOD_EVENT_STATE_PLAYING	0x00000008
+
+typedef enum
+{
+	FMOD_EVENT_CALLBACKTYPE_SYNCPOINT,
+	FMOD_EVENT_CALLBACKTYPE_SOUNDDEF_START,
+	FMOD_EVENT_CALLBACKTYPE_SOUNDDEF_END,
+	FMOD_EVENT_CALLBACKTYPE_STOLEN,
+	FMOD_EVENT_CALLBACKTYPE_EVENTFINISHED
+} FMOD_EVENT_CALLBACKTYPE;
+
+typedef enum
+{
+	FMOD_EVENTPROPERTY_3D_MINDISTANCE,
+	FMOD_EVENTPROPERTY_3D_MAXDISTANCE
+} FMOD_EVENT_PROPERTY;
+
+typedef struct FMOD_EVENT FMOD_EVENT;
+typedef FMOD_RESULT (F_CALLBACK *FMOD_EVENT_CALLBACK)(FMOD_EVENT* event, FMOD_EVENT_CALLBACKTYPE type, void* param1, void* param2, void* userdata);
+
+static const char* FMOD_ErrorString(FMOD_RESULT result)
+{
+	switch(result)
+	{
+		case FMOD_OK:					return "No errors.";
+		case FMOD_ERR_INVALID_PARAM:	return "An invalid parameter was passed to this function.";
+		case FMOD_ERR_INVALID_HANDLE:	return "An invalid object handle was used.";
+		case FMOD_ERR_EVENT_FAILED:		return "An Event failed to be retrieved.";
+		case FMOD_ERR_EVENT_NOTFOUND:	return "The requested event could not be found.";
+	}
+
+	return "Unknown error.";
+}
+
+namespace FMOD
+{
+	class EventSystem;
+	class Event;
+
+	class EventParameter
+	{
+	public:
+		EventParameter(EventSystem* owner, String const& parameterName);
+
+		FMOD_RESULT setValue(float newValue);
+		FMOD_RESULT getValue(float* result) { *result = value; return FMOD_OK; }
+		FMOD_RESULT keyOff();
+
+		String const& getName() const { return name; }
+
+	private:
+		EventSystem* system;
+		String name;
+		float value;
+	};
+
+	class Event
+	{
+	public:
+		/** The instances of one event path, shared by its Events. */
+		struct Template
+		{
+			Template(String const& eventPath, double eventDuration)
+			:	path(eventPath),
+				duration(eventDuration)
+			{
+			}
+
+			String path;
+			double duration;	// in milliseconds, 0 for a looping event
+			OwnedArray<Event> instances;
+		};
+
+		Event(EventSystem* owner, Template* eventTemplate)
+		:	system(owner),
+			parent(eventTemplate),
+			playing(false),
+			paused(false),
+			volume(1.0f),
+			startTime(0),
+			userData(0),
+			callback(0),
+			callbackData(0)
+		{
+		}
+
+		FMOD_RESULT start();
+		FMOD_RESULT stop(bool immediate = false);
+
+		FMOD_RESULT getState(FMOD_EVENT_STATE* state)
+		{
+			*state = FMOD_EVENT_STATE_READY | (playing ? FMOD_EVENT_STATE_PLAYING : 0);
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT setPaused(bool shouldBePaused);
+		FMOD_RESULT getPaused(bool* isPaused) { *isPaused = paused; return FMOD_OK; }
+
+		FMOD_RESULT setVolume(float newVolume) { volume = newVolume; return FMOD_OK; }
+		FMOD_RESULT getVolume(float* result) { *result = volume; return FMOD_OK; }
+
+		FMOD_RESULT set3DAttributes(const FMOD_VECTOR* position, const FMOD_VECTOR* velocity, const FMOD_VECTOR* orientation = 0);
+
+		FMOD_RESULT getParameter(const char* parameterName, EventParameter** parameter)
+		{
+			for(int i = 0; i < parameters.size(); i++)
+			{
+				if(parameters.getUnchecked(i)->getName() == parameterName)
+				{
+					*parameter = parameters.getUnchecked(i);
+					return FMOD_OK;
+				}
+			}
+
+			*parameter = new EventParameter(system, parameterName);
+			parameters.add(*parameter);
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT getPropertyByIndex(int propertyIndex, void* value, bool /*thisInstance*/ = true);
+
+		FMOD_RESULT setCallback(FMOD_EVENT_CALLBACK eventCallback, void* data)
+		{
+			callback = eventCallback;
+			callbackData = data;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT setUserData(void* data) { userData = data; return FMOD_OK; }
+		FMOD_RESULT getUserData(void** data) { *data = userData; return FMOD_OK; }
+
+	private:
+		friend class EventSystem;
+
+		EventSystem* system;
+		Template* parent;
+		bool playing, paused;
+		float volume;
+		double startTime;
+		void* userData;
+		FMOD_EVENT_CALLBACK callback;
+		void* callbackData;
+		OwnedArray<EventParameter> parameters;
+
+		void end(FMOD_EVENT_CALLBACKTYPE type)
+		{
+			playing = false;
+
+			if(callback)
+				callback((FMOD_EVENT*)this, type, 0, 0, callbackData);
+		}
+
+		Event(const Event&);
+		Event& operator=(const Event&);
+	};
+
+	class EventReverb
+	{
+	public:
+		EventReverb(EventSystem* owner)
+		:	system(owner),
+			minDistance(0),
+			maxDistance(0),
+			active(true)
+		{
+			position.x = position.y = position.z = 0;
+		}
+
+		FMOD_RESULT release();
+
+		FMOD_RESULT setProperties(const FMOD_REVERB_PROPERTIES* newProperties)
+		{
+			properties = *newProperties;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT set3DAttributes(const FMOD_VECTOR* newPosition, float newMinDistance, float newMaxDistance)
+		{
+			if(newPosition) position = *newPosition;
+			minDistance = newMinDistance;
+			maxDistance = newMaxDistance;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT setActive(bool shouldBeActive) { active = shouldBeActive; return FMOD_OK; }
+		FMOD_RESULT getActive(bool* isActive) { *isActive = active; return FMOD_OK; }
+
+		FMOD_RESULT get3DAttributes(FMOD_VECTOR* currentPosition, float* currentMinDistance, float* currentMaxDistance)
+		{
+			if(currentPosition) *currentPosition = position;
+			if(currentMinDistance) *currentMinDistance = minDistance;
+			if(currentMaxDistance) *currentMaxDistance = maxDistance;
+			return FMOD_OK;
+		}
+
+	private:
+		EventSystem* system;
+		FMOD_REVERB_PROPERTIES properties;
+		FMOD_VECTOR position;
+		float minDistance, maxDistance;
+		bool active;
+	};
+
+	class EventSystem
+	{
+	public:
+		/** Counts of the calls made and the simulated voices. */
+		struct MockStats
+		{
+			int numGetEvent, numStart, numStop, numSet3DAttributes, numSetParameter, numKeyOff,
+				numSetListener, numSetPaused, numUpdate, numStolen, numFinished, numVirtualStarts, maxPlaying;
+		};
+
+		EventSystem()
+		:	maxPlaybacks(8),
+			defaultDuration(2000.0),
+			maxDistance(100.0f),
+			numChannels(256),
+			numReverbs(0)
+		{
+			zerostruct(stats);
+		}
+
+		FMOD_RESULT init(int maxChannels, FMOD_INITFLAGS, void*, FMOD_EVENT_INITFLAGS)
+		{
+			numChannels = maxChannels;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT release()
+		{
+			logMockStats();
+			delete this;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT setMediaPath(const char*) { return FMOD_OK; }
+		FMOD_RESULT load(const char*, void*, void*) { return FMOD_OK; }
+
+		FMOD_RESULT createReverb(EventReverb** reverb)
+		{
+			*reverb = new EventReverb(this);
+			numReverbs++;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT getReverbPreset(const char*, FMOD_REVERB_PROPERTIES* properties, int* index)
+		{
+			FMOD_REVERB_PROPERTIES preset = FMOD_PRESET_PLAIN;
+			*properties = preset;
+			if(index) *index = 0;
+			return FMOD_OK;
+		}
+
+		FMOD_RESULT setReverbAmbientProperties(FMOD_REVERB_PROPERTIES*) { return FMOD_OK; }
+
+		FMOD_RESULT set3DListenerAttributes(int, const FMOD_VECTOR*, const FMOD_VECTOR*, const FMOD_VECTOR*, const FMOD_VECTOR*)
+		{
+			stats.numSetListener++;
+			return FMOD_OK;
+		}
+
+		/** Returns an instance which isn't playing, a new one if there are fewer
+		 than the max playbacks, or else steals the one which started first. */
+		FMOD_RESULT getEvent(const char* name, FMOD_EVENT_MODE, Event** event)
+		{
+			stats.numGetEvent++;
+
+			Event::Template* eventTemplate = getTemplate(name);
+			OwnedArray<Event>& instances = eventTemplate->instances;
+			Event* oldest = 0;
+
+			for(int i = 0; i < instances.size(); i++)
+			{
+				Event* instance = instances.getUnchecked(i);
+
+				if(!instance->playing)
+				{
+					*event = instance;
+					return FMOD_OK;
+				}
+
+				if(oldest == 0 || instance->startTime < oldest->startTime)
+					oldest = instance;
+			}
+
+			if(instances.size() < maxPlaybacks)
+			{
+				*event = new Event(this, eventTemplate);
+				instances.add(*event);
+				return FMOD_OK;
+			}
+
+			stats.numStolen++;
+			playing.removeValue(oldest);
+			oldest->end(FMOD_EVENT_CALLBACKTYPE_STOLEN);
+
+			*event = oldest;
+			return FMOD_OK;
+		}
+
+		/** Ends the events which have played for their duration. */
+		FMOD_RESULT update()
+		{
+			stats.numUpdate++;
+
+			const double now = Time::getMillisecondCounterHiRes();
+
+			for(int i = playing.size()-1; i >= 0; i--)
+			{
+				Event* event = playing.getUnchecked(i);
+				const double duration = event->parent->duration;
+
+				if(duration > 0 && !event->paused && now - event->startTime >= duration)
+				{
+					stats.numFinished++;
+					playing.remove(i);
+					event->end(FMOD_EVENT_CALLBACKTYPE_EVENTFINISHED);
+				}
+			}
+
+			return FMOD_OK;
+		}
+
+		/** The most instances of each event path, FMOD Designer's max playbacks (8 by default). */
+		void setMockMaxPlaybacks(int newMaxPlaybacks) { maxPlaybacks = jmax(1, newMaxPlaybacks); }
+
+		/** How long events play for in seconds, 0 for looping (2 by default). Applies to paths not used yet. */
+		void setMockDefaultDuration(double seconds) { defaultDuration = seconds * 1000.0; }
+
+		/** How long one event path plays for in seconds, 0 for looping. */
+		void setMockDuration(const char* name, double seconds) { getTemplate(name)->duration = seconds * 1000.0; }
+
+		/** The 3D max distance given for every event (100 by default). */
+		void setMockMaxDistance(float newMaxDistance) { maxDistance = newMaxDistance; }
+
+		MockStats const& getMockStats() const { return stats; }
+		int getMockNumPlaying() const { return playing.size(); }
+
+		void logMockStats() const
+		{
+			String summary;
+			summary << "Mock FMOD: " << stats.numGetEvent << " getEvent, "
+					<< stats.numStart << " start, " << stats.numStop << " stop, "
+					<< stats.numSet3DAttributes << " set3DAttributes, "
+					<< stats.numSetParameter << " setValue, " << stats.numKeyOff << " keyOff, "
+					<< stats.numSetListener << " set3DListenerAttributes, " << stats.numSetPaused << " setPaused, "
+					<< stats.numUpdate << " update, "
+					<< stats.numStolen << " stolen, " << stats.numFinished << " finished, "
+					<< stats.numVirtualStarts << " virtual, " << stats.maxPlaying << " most playing";
+			Logger::outputDebugString(summary);
+		}
+
+	private:
+		friend class Event;
+		friend class EventParameter;
+		friend class EventReverb;
+
+		PointerDictionary<Event::Template> templates;
+		OwnedArray<Event::Template> templateStorage;
+		Array<Event*> playing;
+		MockStats stats;
+		int maxPlaybacks;
+		double defaultDuration;
+		float maxDistance;
+		int numChannels;
+		int numReverbs;
+
+		~EventSystem() {}
+
+		Event::Template* getTemplate(const char* name)
+		{
+			const int length = (int)strlen(name);
+			const uint32 hash = PointerDictionary<Event::Template>::hashName(name, length);
+			Event::Template* eventTemplate = templates.get(name, length, hash);
+
+			if(eventTemplate == 0)
+			{
+				eventTemplate = new Event::Template(name, defaultDuration);
+				templateStorage.add(eventTemplate);
+				templates.add(eventTemplate->path, hash, eventTemplate);
+			}
+
+			return eventTemplate;
+		}
+
+		EventSystem(const EventSystem&);
+		EventSystem& operator=(const EventSystem&);
+	};
+
+	inline EventParameter::EventParameter(EventSystem* owner, String const& parameterName)
+	:	system(owner),
+		name(parameterName),
+		value(0)
+	{
+	}
+
+	inline FMOD_RESULT EventParameter::setValue(float newValue)
+	{
+		system->stats.numSetParameter++;
+		value = newValue;
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT EventParameter::keyOff()
+	{
+		system->stats.numKeyOff++;
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT Event::start()
+	{
+		system->stats.numStart++;
+		startTime = Time::getMillisecondCounterHiRes();
+
+		if(!playing)
+		{
+			if(system->playing.size() >= system->numChannels)
+				system->stats.numVirtualStarts++;
+
+			playing = true;
+			system->playing.add(this);
+			system->stats.maxPlaying = jmax(system->stats.maxPlaying, system->playing.size());
+		}
+
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT Event::stop(bool)
+	{
+		system->stats.numStop++;
+
+		if(playing)
+		{
+			system->playing.removeValue(this);
+			end(FMOD_EVENT_CALLBACKTYPE_EVENTFINISHED);
+		}
+
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT Event::setPaused(bool shouldBePaused)
+	{
+		system->stats.numSetPaused++;
+		paused = shouldBePaused;
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT Event::set3DAttributes(const FMOD_VECTOR*, const FMOD_VECTOR*, const FMOD_VECTOR*)
+	{
+		system->stats.numSet3DAttributes++;
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT Event::getPropertyByIndex(int propertyIndex, void* value, bool)
+	{
+		if(propertyIndex != FMOD_EVENTPROPERTY_3D_MAXDISTANCE)
+			return FMOD_ERR_INVALID_PARAM;
+
+		*(float*)value = system->maxDistance;
+		return FMOD_OK;
+	}
+
+	inline FMOD_RESULT EventReverb::release()
+	{
+		system->numReverbs--;
+		delete this;
+		return FMOD_OK;
+	}
+}
+
+inline FMOD_RESULT EventSystem_Create(FMOD::EventSystem** eventsystem)
+{
+	*eventsystem = new FMOD::EventSystem();
+	return FMOD_OK;
+}
+
+#endif // MOCKEVENTSYSTEM_H
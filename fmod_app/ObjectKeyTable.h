@@ -0,0 +1,205 @@
+#ifndef OBJECTKEYTABLE_H
+#define OBJECTKEYTABLE_H
+
+#include <juce/juce.h>
+#include "PointerDictionary.h"
+
+/** Interns (object-name, gameObjectInstanceID) pairs as compact integer handles.
+
+ A handle is allocated once when an object is created (usually in handleCreate())
+ and can then be used to index plain arrays of per-object data. Looking up the
+ handle for a later message hashes the name and the id together and never builds
+ a combined string, so no memory is allocated on the network thread.
+
+ Handles of released keys are reused, so the largest handle stays close to the
+ number of live objects. */
+class ObjectKeyTable
+{
+public:
+	enum { invalidHandle = -1 };
+
+	ObjectKeyTable()
+	:	table(0),
+		capacity(0),
+		numUsed(0)
+	{
+	}
+
+	~ObjectKeyTable()
+	{
+		delete[] table;
+	}
+
+	/** Returns the handle for a key, allocating a new one if the key hasn't been seen. */
+	int intern(String const& name, int gameObjectInstanceID)
+	{
+		const uint32 hash = hashKey(name, gameObjectInstanceID);
+
+		if(numUsed > 0)
+		{
+			int existing = table[findSlot(name, gameObjectInstanceID, hash)];
+
+			if(existing != invalidHandle)
+				return existing;
+		}
+
+		if((numUsed + 1) * 4 > capacity * 3)
+			resize(capacity == 0 ? 64 : capacity * 2);
+
+		int handle;
+
+		if(freeHandles.size() > 0)
+		{
+			handle = freeHandles.getLast();
+			freeHandles.removeLast();
+		}
+		else
+		{
+			handle = entries.size();
+			entries.add(Entry());
+		}
+
+		Entry& entry = entries.getReference(handle);
+		entry.name = name;
+		entry.gameObjectInstanceID = gameObjectInstanceID;
+		entry.hash = hash;
+		entry.live = true;
+
+		table[findSlot(name, gameObjectInstanceID, hash)] = handle;
+		numUsed++;
+
+		return handle;
+	}
+
+	/** Returns the handle for a key or invalidHandle if it hasn't been interned. */
+	int find(String const& name, int gameObjectInstanceID) const
+	{
+		if(numUsed == 0)
+			return invalidHandle;
+
+		return table[findSlot(name, gameObjectInstanceID, hashKey(name, gameObjectInstanceID))];
+	}
+
+	/** Forgets a key. Its handle may be returned by a later call to intern(). */
+	void release(int handle)
+	{
+		if(!isPositiveAndBelow(handle, entries.size()) || !entries.getReference(handle).live)
+			return;
+
+		Entry& entry = entries.getReference(handle);
+		const int mask = capacity - 1;
+		int hole = findSlot(entry.name, entry.gameObjectInstanceID, entry.hash);
+		int next = (hole + 1) & mask;
+
+		// backward-shift deletion, as in PointerDictionary
+		while(table[next] != invalidHandle)
+		{
+			int home = (int)(entries.getReference(table[next]).hash & (uint32)mask);
+
+			if(((next - home) & mask) >= ((next - hole) & mask))
+			{
+				table[hole] = table[next];
+				hole = next;
+			}
+
+			next = (next + 1) & mask;
+		}
+
+		table[hole] = invalidHandle;
+		numUsed--;
+
+		entry.name = String::empty;
+		entry.live = false;
+		freeHandles.add(handle);
+	}
+
+	/** One more than the largest handle which has been allocated.
+	 Arrays indexed by handle need to be at least this big. */
+	int getNumHandles() const { return entries.size(); }
+
+	/** Returns the name that a handle was interned with. */
+	String const& getName(int handle) const { return entries.getReference(handle).name; }
+
+	/** Returns the gameObjectInstanceID that a handle was interned with. */
+	int getInstanceID(int handle) const { return entries.getReference(handle).gameObjectInstanceID; }
+
+	/** Forgets all the keys. */
+	void clear()
+	{
+		for(int i = 0; i < capacity; i++)
+			table[i] = invalidHandle;
+
+		entries.clear();
+		freeHandles.clear();
+		numUsed = 0;
+	}
+
+private:
+	struct Entry
+	{
+		Entry() : gameObjectInstanceID(0), hash(0), live(false) {}
+
+		String name;
+		int gameObjectInstanceID;
+		uint32 hash;
+		bool live;
+	};
+
+	Array<Entry> entries;		// indexed by handle
+	Array<int> freeHandles;
+	int* table;					// open-addressing index of handles, invalidHandle if empty
+	int capacity;
+	int numUsed;
+
+	static uint32 hashKey(String const& name, int gameObjectInstanceID)
+	{
+		uint32 hash = PointerDictionary<void>::hashName(name);
+		hash ^= (uint32)gameObjectInstanceID * 0x9e3779b1u;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	/** Returns the table index holding this key, or the empty index where it would go. */
+	int findSlot(String const& name, int gameObjectInstanceID, uint32 hash) const
+	{
+		const int mask = capacity - 1;
+		int index = (int)(hash & (uint32)mask);
+
+		while(table[index] != invalidHandle)
+		{
+			const Entry& entry = entries.getReference(table[index]);
+
+			if(entry.hash == hash
+			   && entry.gameObjectInstanceID == gameObjectInstanceID
+			   && entry.name == name)
+				return index;
+
+			index = (index + 1) & mask;
+		}
+
+		return index;
+	}
+
+	void resize(int newCapacity)
+	{
+		delete[] table;
+		table = new int[newCapacity];
+		capacity = newCapacity;
+
+		for(int i = 0; i < capacity; i++)
+			table[i] = invalidHandle;
+
+		for(int handle = 0; handle < entries.size(); handle++)
+		{
+			const Entry& entry = entries.getReference(handle);
+
+			if(entry.live)
+				table[findSlot(entry.name, entry.gameObjectInstanceID, entry.hash)] = handle;
+		}
+	}
+
+	ObjectKeyTable(const ObjectKeyTable&);
+	ObjectKeyTable& operator=(const ObjectKeyTable&);
+};
+
+#endif // OBJECTKEYTABLE_H
@@ -0,0 +1,612 @@
+#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+#include "AttributeKernel.h"
+#include "EventPool.h"
+#include "LockFreeQueue.h"
+#include "ParameterCache.h"
+#include "SpatialGrid.h"
+
+/** A dense structure-of-arrays store for the vector data of every game object.
+
+ Each object occupies a slot and its position, velocity and direction live in
+ contiguous arrays indexed by slot, so passes over many objects (such as
+ applying this tick's moves) walk memory in order rather than chasing a
+ separately allocated object per game object. Slots of destroyed objects are
+ kept on a free list and reused.
+
+ Objects are referred to by a Handle which records the slot's generation. The
+ generation changes whenever a slot is freed so a handle to a destroyed object
+ never refers to whatever reuses its slot.
+
+ Moved objects which are out of earshot of the listener (beyond the largest
+ maximum distance of their Events) aren't updated; they stay in the list of
+ moved objects until the listener comes within range.
+
+ Every object is also kept in a SpatialGrid by position. Objects with looping
+ Events (see VectorData::addLoopingEvent()) have them paused by
+ pauseOutOfRange() while the listener is out of earshot and resumed when it
+ comes back, so distant rivers and the like don't take up voices. Only the
+ grid cells around the listener and the looping objects currently playing
+ are looked at each tick, not every object.
+
+ Events are removed from their objects when they finish or are stolen. FMOD
+ reports this through an event callback, which only pushes the Event onto a
+ lock-free queue; reapFinished() then drains the queue once per tick and
+ swaps each Event out of its object's array in constant time. Nothing polls
+ the state of every Event.
+
+ The store also keeps a ParameterCache of its Events' parameters (see
+ getParameters()). The values written to an Event are forgotten when it leaves
+ its object, since it may then be reused for another sound.
+
+ Use VectorData for the operations on a single object.
+ */
+class ObjectStore
+{
+public:
+	/** A generation-checked reference to an object in the store. */
+	class Handle
+	{
+	public:
+		Handle() : index(-1), generation(0) {}
+		Handle(int slot, uint32 slotGeneration) : index(slot), generation(slotGeneration) {}
+
+		bool isNull() const { return index < 0; }
+		bool operator==(Handle const& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(Handle const& other) const { return !operator==(other); }
+
+		int index;
+		uint32 generation;
+	};
+
+	ObjectStore()
+	:	grid(32.0f),		// metres, about the range of the looping sounds
+		loopingRange(0),
+		numPaused(0),
+		completions(completionQueueSize)
+	{
+	}
+
+	~ObjectStore()
+	{
+		clear();
+	}
+
+	/** Allocates a slot for a new object with zeroed vectors and no events. */
+	Handle create()
+	{
+		int index;
+
+		if(freeSlots.size() > 0)
+		{
+			index = freeSlots.getLast();
+			freeSlots.removeLast();
+		}
+		else
+		{
+			index = generations.size();
+
+			Vector3 zero;
+			zero.x = zero.y = zero.z = 0;
+
+			positions.add(zero);
+			velocities.add(zero);
+			directions.add(zero);
+			events.add(Array<Event*>());
+			maxDistances.add(0);
+			distances.add(0);
+			inRange.add(0);
+			generations.add(0);
+			live.add(false);
+			moved.add(false);
+			looping.add(false);
+			paused.add(false);
+		}
+
+		Vector3& pos = positions.getReference(index);
+		Vector3& vel = velocities.getReference(index);
+		Vector3& dir = directions.getReference(index);
+		pos.x = pos.y = pos.z = 0;
+		vel.x = vel.y = vel.z = 0;
+		dir.x = dir.y = dir.z = 0;
+		maxDistances.set(index, 0);
+		grid.insert(index, pos);
+
+		live.set(index, true);
+		return Handle(index, generations[index]);
+	}
+
+	/** Stops an object's events and frees its slot. Invalid handles are ignored. */
+	void destroy(Handle handle)
+	{
+		if(!isValid(handle))
+			return;
+
+		const int index = handle.index;
+
+		// FMOD keeps an instance paused, so it mustn't go back paused
+		if(paused[index])
+			setPaused(index, false);
+
+		Array<Event*>& objectEvents = events.getReference(index);
+
+		for(int i = 0; i < objectEvents.size(); i++)
+		{
+			Event* event = objectEvents.getUnchecked(i);
+
+			if(isPlaying(event))
+				ERRCHECK(event->stop());
+
+			locations.remove(event);
+			parameters.forgetValues(event);
+			EventPool::release(event);
+		}
+
+		objectEvents.clear();
+
+		if(moved[index])
+		{
+			movedSlots.removeValue(index);
+			moved.set(index, false);
+		}
+
+		if(looping[index])
+		{
+			audibleLooping.removeValue(index);
+			looping.set(index, false);
+		}
+
+		grid.remove(index);
+		live.set(index, false);
+		generations.set(index, generations[index] + 1);
+		freeSlots.add(index);
+	}
+
+	/** True if the handle refers to an object which hasn't been destroyed. */
+	bool isValid(Handle handle) const
+	{
+		return isPositiveAndBelow(handle.index, generations.size())
+			&& live[handle.index]
+			&& generations[handle.index] == handle.generation;
+	}
+
+	/** Destroys all the objects. */
+	void clear()
+	{
+		for(int index = 0; index < generations.size(); index++)
+		{
+			if(live[index])
+				destroy(Handle(index, generations[index]));
+		}
+
+		movedSlots.clear();
+		locations.clear();
+		audibleLooping.clear();
+		loopingRange = 0;
+		parameters.forgetAll();
+	}
+
+	/** The number of slots (live or free), the arrays returned by getPositions() etc. are this long. */
+	int getNumSlots() const { return generations.size(); }
+	bool isLive(int index) const { return live[index]; }
+
+	const Vector3* getPositions() const { return positions.getRawDataPointer(); }
+	const Vector3* getVelocities() const { return velocities.getRawDataPointer(); }
+	const Vector3* getDirections() const { return directions.getRawDataPointer(); }
+
+	/** Each object's distance from the listener as of the last flushMoved(). */
+	const float* getDistances() const { return distances.getRawDataPointer(); }
+
+	/** Apply the latest vectors of every object moved since the last call to
+	 its Events, one set3DAttributes() call per Event. Objects out of range of
+	 the listener are left until a later call finds them in range. */
+	void flushMoved(Vector3 const& listener)
+	{
+		if(movedSlots.size() == 0)
+			return;
+
+		AttributeKernel::getCullFunction()(positions.getRawDataPointer(),
+										   maxDistances.getRawDataPointer(),
+										   getNumSlots(),
+										   listener,
+										   distances.getRawDataPointer(),
+										   inRange.getRawDataPointer());
+		int numWaiting = 0;
+
+		for(int i = 0; i < movedSlots.size(); i++)
+		{
+			const int index = movedSlots.getUnchecked(i);
+
+			if(!inRange[index] && events.getReference(index).size() > 0)
+			{
+				movedSlots.set(numWaiting++, index);
+			}
+			else
+			{
+				moved.set(index, false);
+				updateEvents(index);
+			}
+		}
+
+		movedSlots.removeRange(numWaiting, movedSlots.size() - numWaiting);
+	}
+
+	/** Pauses the Events of looping objects the listener has moved out of
+	 earshot of, and resumes those it has come back within earshot of.
+	 Call once per tick before EventSystem::update(). */
+	void pauseOutOfRange(Vector3 const& listener)
+	{
+		// the paused objects near enough to be heard again
+		if(numPaused > 0)
+		{
+			nearby.clearQuick();
+			grid.findWithin(listener, loopingRange, nearby);
+
+			for(int i = 0; i < nearby.size(); i++)
+			{
+				const int index = nearby.getUnchecked(i);
+
+				const float range = maxDistances[index];
+
+				if(paused[index] && distanceSquared(index, listener) <= range * range)
+				{
+					setPaused(index, false);
+					audibleLooping.add(index);
+				}
+			}
+		}
+
+		// a little further away to pause than to resume, so an object at the edge doesn't flicker
+		const float pauseScale = 1.1f;
+		int numAudible = 0;
+
+		for(int i = 0; i < audibleLooping.size(); i++)
+		{
+			const int index = audibleLooping.getUnchecked(i);
+
+			const float range = maxDistances[index] * pauseScale;
+
+			if(distanceSquared(index, listener) > range * range)
+				setPaused(index, true);
+			else
+				audibleLooping.set(numAudible++, index);
+		}
+
+		audibleLooping.removeRange(numAudible, audibleLooping.size() - numAudible);
+	}
+
+	/** The parameters of the Events, looked up once per Event and name. Events
+	 which aren't in the store may use it too, until they're next reused. */
+	ParameterCache& getParameters() { return parameters; }
+
+	/** The number of looping objects whose Events are paused. */
+	int getNumPaused() const { return numPaused; }
+
+	/** Removes the Events which FMOD has reported as finished or stolen from their
+	 objects and returns them to their EventPools. Call once per tick, on the
+	 thread which calls EventSystem::update(). */
+	void reapFinished()
+	{
+		Event* event;
+
+		while(completions.pop(event))
+		{
+			// the report is stale if the Event has been started again since
+			if(locations.find(event) != 0 && !isPlaying(event))
+			{
+				detachEvent(event);
+				EventPool::release(event);
+			}
+		}
+
+		// reports were lost while the queue was full, so look at every Event
+		if(completionsOverflowed.exchange(0) != 0)
+		{
+			for(int index = 0; index < getNumSlots(); index++)
+			{
+				Array<Event*>& objectEvents = events.getReference(index);
+
+				for(int i = objectEvents.size()-1; i >= 0; i--)
+				{
+					event = objectEvents.getUnchecked(i);
+
+					if(!isPlaying(event))
+					{
+						detachEvent(event);
+						EventPool::release(event);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	friend class VectorData;
+
+	/** An open-addressing map from each Event in the store to its slot and its
+	 index in that slot's events, so an Event can be removed without a search. */
+	class EventLocations
+	{
+	public:
+		struct Location
+		{
+			Event* event;	// 0 if the entry is empty
+			int slot, index;
+		};
+
+		EventLocations()
+		:	capacity(0),
+			numUsed(0)
+		{
+		}
+
+		Location* find(Event* event)
+		{
+			if(numUsed == 0)
+				return 0;
+
+			Location& location = table[findEntry(event)];
+			return location.event != 0 ? &location : 0;
+		}
+
+		void set(Event* event, int slot, int index)
+		{
+			if((numUsed + 1) * 4 > capacity * 3)
+				resize(capacity == 0 ? 64 : capacity * 2);
+
+			Location& location = table[findEntry(event)];
+
+			if(location.event == 0)
+				numUsed++;
+
+			location.event = event;
+			location.slot = slot;
+			location.index = index;
+		}
+
+		void remove(Event* event)
+		{
+			if(numUsed == 0)
+				return;
+
+			const int mask = capacity - 1;
+			int hole = findEntry(event);
+
+			if(table[hole].event == 0)
+				return;
+
+			int next = (hole + 1) & mask;
+
+			// backward-shift deletion, as in PointerDictionary
+			while(table[next].event != 0)
+			{
+				int home = (int)(hash(table[next].event) & (uint32)mask);
+
+				if(((next - home) & mask) >= ((next - hole) & mask))
+				{
+					table[hole] = table[next];
+					hole = next;
+				}
+
+				next = (next + 1) & mask;
+			}
+
+			table[hole].event = 0;
+			numUsed--;
+		}
+
+		void clear()
+		{
+			for(int i = 0; i < capacity; i++)
+				table[i].event = 0;
+
+			numUsed = 0;
+		}
+
+	private:
+		HeapBlock<Location> table;
+		int capacity, numUsed;
+
+		static uint32 hash(Event* event)
+		{
+			uint32 hash = (uint32)((pointer_sized_uint)event >> 4) * 0x9e3779b1u;
+			return hash ^ (hash >> 16);
+		}
+
+		int findEntry(Event* event) const
+		{
+			const int mask = capacity - 1;
+			int index = (int)(hash(event) & (uint32)mask);
+
+			while(table[index].event != 0 && table[index].event != event)
+				index = (index + 1) & mask;
+
+			return index;
+		}
+
+		void resize(int newCapacity)
+		{
+			HeapBlock<Location> oldTable;
+			oldTable.swapWith(table);
+			const int oldCapacity = capacity;
+
+			table.calloc(newCapacity);
+			capacity = newCapacity;
+
+			for(int i = 0; i < oldCapacity; i++)
+			{
+				if(oldTable[i].event != 0)
+					table[findEntry(oldTable[i].event)] = oldTable[i];
+			}
+		}
+	};
+
+	enum { completionQueueSize = 1024 };
+
+	Array<Vector3> positions, velocities, directions;
+	Array< Array<Event*> > events;
+	Array<float> maxDistances;		// the largest 3D max distance of each object's Events
+	Array<float> distances;
+	Array<uint8> inRange;
+	Array<uint32> generations;
+	Array<bool> live;
+	Array<bool> moved;
+	Array<bool> looping;		// has looping Events which pauseOutOfRange() looks after
+	Array<bool> paused;
+	Array<int> movedSlots;		// slots moved since the last flushMoved()
+	Array<int> freeSlots;
+	SpatialGrid grid;
+	Array<int> audibleLooping;	// looping slots which aren't paused
+	Array<int> nearby;			// used by pauseOutOfRange()
+	float loopingRange;			// the largest max distance of any looping object
+	int numPaused;
+	EventLocations locations;
+	LockFreeQueue<Event*> completions;		// Events reported finished by FMOD
+	Atomic<int> completionsOverflowed;
+	ParameterCache parameters;
+
+	void setVectors(int index, const Vector3* newPos, const Vector3* newVel, const Vector3* newDir)
+	{
+		if(newPos)
+		{
+			positions.set(index, *newPos);
+			grid.move(index, *newPos);
+		}
+
+		if(newVel) velocities.set(index, *newVel);
+		if(newDir) directions.set(index, *newDir);
+
+		if(!moved[index])
+		{
+			moved.set(index, true);
+			movedSlots.add(index);
+		}
+	}
+
+	static bool isPlaying(Event* event)
+	{
+		FMOD_EVENT_STATE state;
+		FMOD_RESULT error = event->getState(&state);
+
+		return (error == FMOD_OK) && (state & FMOD_EVENT_STATE_PLAYING);
+	}
+
+	static FMOD_RESULT F_CALLBACK eventCallback(FMOD_EVENT* event, FMOD_EVENT_CALLBACKTYPE type,
+												void* /*param1*/, void* /*param2*/, void* userdata)
+	{
+		if(type == FMOD_EVENT_CALLBACKTYPE_EVENTFINISHED || type == FMOD_EVENT_CALLBACKTYPE_STOLEN)
+		{
+			ObjectStore* store = (ObjectStore*)userdata;
+
+			if(!store->completions.push((Event*)event))
+				store->completionsOverflowed = 1;
+		}
+
+		return FMOD_OK;
+	}
+
+	/** Adds an Event to an object's events, moving it from another object if necessary.
+	 @return false if the Event was already one of this object's events. */
+	bool attachEvent(int index, Event* event)
+	{
+		EventLocations::Location* location = locations.find(event);
+
+		if(location != 0)
+		{
+			if(location->slot == index)
+				return false;
+
+			detachEvent(event);
+		}
+
+		Array<Event*>& objectEvents = events.getReference(index);
+		locations.set(event, index, objectEvents.size());
+		objectEvents.add(event);
+
+		ERRCHECK(event->setCallback(eventCallback, this));
+		return true;
+	}
+
+	/** Removes an Event from its object's events by moving the last Event into its place. */
+	void detachEvent(Event* event)
+	{
+		EventLocations::Location* location = locations.find(event);
+
+		if(location == 0)
+			return;
+
+		const int index = location->index;
+		Array<Event*>& objectEvents = events.getReference(location->slot);
+		Event* last = objectEvents.getLast();
+
+		objectEvents.set(index, last);
+		objectEvents.removeLast();
+		locations.remove(event);
+		parameters.forgetValues(event);
+
+		if(last != event)
+			locations.find(last)->index = index;
+	}
+
+	void updateEvents(int index)
+	{
+		Array<Event*>& objectEvents = events.getReference(index);
+		const Vector3* pos = &positions.getReference(index);
+		const Vector3* vel = &velocities.getReference(index);
+		const Vector3* dir = &directions.getReference(index);
+
+		for(int i = 0; i < objectEvents.size(); i++)
+			ERRCHECK(objectEvents.getUnchecked(i)->set3DAttributes(pos, vel, dir));
+	}
+
+	/** Marks an object as having looping Events, it's treated as in earshot until the next pauseOutOfRange(). */
+	void setLooping(int index)
+	{
+		loopingRange = jmax(loopingRange, maxDistances[index]);
+
+		if(paused[index])
+			setPaused(index, false);
+		else if(looping[index])
+			return;
+
+		looping.set(index, true);
+		audibleLooping.add(index);
+	}
+
+	void setPaused(int index, bool shouldBePaused)
+	{
+		Array<Event*>& objectEvents = events.getReference(index);
+
+		for(int i = 0; i < objectEvents.size(); i++)
+			ERRCHECK(objectEvents.getUnchecked(i)->setPaused(shouldBePaused));
+
+		paused.set(index, shouldBePaused);
+		numPaused += shouldBePaused ? 1 : -1;
+	}
+
+	float distanceSquared(int index, Vector3 const& listener) const
+	{
+		const Vector3& pos = positions.getReference(index);
+		const float dx = pos.x - listener.x, dy = pos.y - listener.y, dz = pos.z - listener.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	void stopEvents(int index)
+	{
+		Array<Event*>& objectEvents = events.getReference(index);
+
+		for(int i = objectEvents.size()-1; i >= 0; i--)
+		{
+			Event* event = objectEvents.getUnchecked(i);
+
+			if(isPlaying(event))
+				ERRCHECK(event->stop());
+		}
+	}
+
+	ObjectStore(const ObjectStore&);
+	ObjectStore& operator=(const ObjectStore&);
+};
+
+#endif // OBJECTSTORE_H
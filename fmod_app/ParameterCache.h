@@ -0,0 +1,207 @@
+#ifndef PARAMETERCACHE_H
+#define PARAMETERCACHE_H
+
+#include <juce/juce.h>
+
+/** Remembers the EventParameter of each Event and parameter name, and the value last written to it.
+
+ Event::getParameter() searches the event's parameters by name, so setting a
+ parameter every tick costs a string search per Event each time. Here the
+ parameters are named by their index in a table of names given once to
+ setNames(), each (Event, index) pair is looked up in FMOD once and its
+ EventParameter kept in an open-addressing table, so later writes cost a hash
+ with no string comparisons. setValue() also skips
+ the write when the value is within an epsilon of the last one written, so a
+ parameter which isn't changing makes no FMOD calls at all.
+
+ An EventParameter belongs to its Event instance and stays valid as long as
+ the instance does (until the EventSystem is released), so handles are never
+ looked up twice. The values are only as good as the knowledge that nothing
+ else has changed the parameter: call forgetValues() when an Event is reused
+ for another sound, and write with evenIfUnchanged where the value must be
+ set, e.g., just before a reused Event is started.
+ */
+class ParameterCache
+{
+public:
+	/** @param epsilon	Writes within this of the last value written are skipped. */
+	ParameterCache(float epsilon = 1.0e-4f)
+	:	tolerance(epsilon),
+		names(0),
+		numNames(0),
+		capacity(0),
+		numUsed(0),
+		numLookups(0),
+		numWrites(0),
+		numSkipped(0)
+	{
+	}
+
+	/** Sets the names of the parameters, the index of each is what the other functions take.
+	 Call this before anything else, the array isn't copied so must last as long as the cache. */
+	void setNames(const char* const* parameterNames, int numParameterNames)
+	{
+		forgetAll();
+		names = parameterNames;
+		numNames = numParameterNames;
+	}
+
+	/** Returns an Event's parameter, or 0 if it has none by that name.
+	 FMOD is only asked the first time for each Event and name.
+	 @param name	The index of the parameter's name in the array given to setNames(). */
+	EventParameter* getParameter(Event* event, int name)
+	{
+		return findOrAdd(event, name).param;
+	}
+
+	/** Sets an Event's parameter unless it already has the value.
+	 @param name				The index of the parameter's name in the array given to setNames().
+	 @param evenIfUnchanged		Writes the value whatever was written last.
+	 @return					false if the Event has no parameter by that name. */
+	bool setValue(Event* event, int name, float value, bool evenIfUnchanged = false)
+	{
+		Entry& entry = findOrAdd(event, name);
+
+		if(entry.param == 0)
+			return false;
+
+		if(entry.hasValue && !evenIfUnchanged && fabsf(value - entry.value) <= tolerance)
+		{
+			numSkipped++;
+			return true;
+		}
+
+		ERRCHECK(entry.param->setValue(value));
+		entry.value = value;
+		entry.hasValue = true;
+		numWrites++;
+		return true;
+	}
+
+	/** Forgets the values written to an Event's parameters, but not the parameters.
+	 Call when the Event may have been changed by something else, e.g., returned to its EventPool. */
+	void forgetValues(Event* event)
+	{
+		if(numUsed == 0)
+			return;
+
+		for(int name = 0; name < numNames; name++)
+		{
+			Entry& entry = table[findEntry(event, name)];
+
+			if(entry.event != 0)
+				entry.hasValue = false;
+		}
+	}
+
+	/** Forgets every Event, call before the EventSystem is released. The counts are kept. */
+	void forgetAll()
+	{
+		for(int i = 0; i < capacity; i++)
+			table[i].event = 0;
+
+		numUsed = 0;
+	}
+
+	int getNumLookups() const { return numLookups; }
+	int getNumWrites() const { return numWrites; }
+	int getNumSkipped() const { return numSkipped; }
+
+	void logStats() const
+	{
+		Logger::outputDebugString("Parameters: " + String(numLookups) + " looked up, " + String(numWrites) + " written, "
+								  + String(numSkipped) + " unchanged");
+	}
+
+	/** Forgets every Event and the counts. */
+	void clear()
+	{
+		forgetAll();
+		numLookups = numWrites = numSkipped = 0;
+	}
+
+private:
+	struct Entry
+	{
+		Event* event;			// 0 if the entry is empty
+		int name;				// the index in names
+		EventParameter* param;	// 0 if the Event has no such parameter
+		float value;
+		bool hasValue;			// whether value is known to be the parameter's value
+	};
+
+	const float tolerance;
+	const char* const* names;	// from setNames(), only a handful
+	int numNames;
+	HeapBlock<Entry> table;
+	int capacity, numUsed;
+	int numLookups, numWrites, numSkipped;
+
+	static uint32 hash(Event* event, int name)
+	{
+		uint32 hash = (uint32)((pointer_sized_uint)event >> 4) * 0x9e3779b1u;
+		hash ^= (uint32)name * 0x85ebca6bu;
+		return hash ^ (hash >> 16);
+	}
+
+	int findEntry(Event* event, int name) const
+	{
+		const int mask = capacity - 1;
+		int index = (int)(hash(event, name) & (uint32)mask);
+
+		while(table[index].event != 0 && (table[index].event != event || table[index].name != name))
+			index = (index + 1) & mask;
+
+		return index;
+	}
+
+	Entry& findOrAdd(Event* event, int name)
+	{
+		jassert(isPositiveAndBelow(name, numNames));
+
+		if(numUsed > 0)
+		{
+			Entry& entry = table[findEntry(event, name)];
+
+			if(entry.event != 0)
+				return entry;
+		}
+
+		if((numUsed + 1) * 4 > capacity * 3)
+			resize(capacity == 0 ? 64 : capacity * 2);
+
+		Entry& entry = table[findEntry(event, name)];
+		entry.event = event;
+		entry.name = name;
+		entry.hasValue = false;
+		numUsed++;
+		numLookups++;
+
+		// not error checked, some events don't have every parameter
+		if(event->getParameter(names[name], &entry.param) != FMOD_OK)
+			entry.param = 0;
+
+		return entry;
+	}
+
+	void resize(int newCapacity)
+	{
+		HeapBlock<Entry> oldTable;
+		oldTable.swapWith(table);
+		const int oldCapacity = capacity;
+
+		table.calloc(newCapacity);
+		capacity = newCapacity;
+
+		for(int i = 0; i < oldCapacity; i++)
+		{
+			if(oldTable[i].event != 0)
+				table[findEntry(oldTable[i].event, oldTable[i].name)] = oldTable[i];
+		}
+	}
+
+	ParameterCache(const ParameterCache&);
+	ParameterCache& operator=(const ParameterCache&);
+};
+
+#endif // PARAMETERCACHE_H
@@ -3,83 +3,247 @@
 
 #include <juce/juce.h>
 
-/** A class to store pointers with an associated string key. */
+/** A class to store pointers with an associated string key.
+
+ The keys are held in an open-addressing hash table (linear probing) along with
+ their precomputed hashes so add(), get() and remove() take the same time
+ whether there are 10 or 10,000 objects in the dictionary. A key's characters
+ are only compared when its hash already matches.
+
+ Keys can also be looked up directly from UTF-8 characters which aren't in a
+ String (e.g., a token in a network buffer) without allocating anything. */
 template<class ObjectType>
 class PointerDictionary
 {
 private:
-	StringArray ids;
-	Array<ObjectType*> objects;
-	
+	struct Slot
+	{
+		Slot() : length(0), hash(0), object(0), used(false) {}
+
+		String name;
+		int length;		// of the name in UTF-8 bytes
+		uint32 hash;
+		ObjectType* object;
+		bool used;
+	};
+
+	Slot* slots;
+	int capacity;	// always a power of two (or zero before the first add)
+	int numUsed;
+
 public:
-	
+	PointerDictionary()
+	:	slots(0),
+		capacity(0),
+		numUsed(0)
+	{
+	}
+
+	~PointerDictionary()
+	{
+		delete[] slots;
+	}
+
+	/** Returns the hash used for a key.
+	 Callers that look up the same key repeatedly can compute this once and
+	 pass it to the overloads of add(), get() and remove() which take a hash. */
+	static uint32 hashName(String const& name)
+	{
+		const char* text = (const char*)name.toUTF8();
+		return hashName(text, (int)strlen(text));
+	}
+
+	/** Returns the hash for a key given as UTF-8 characters. */
+	static uint32 hashName(const char* text, int length)
+	{
+		// FNV-1a over the UTF-8 bytes
+		uint32 hash = 2166136261u;
+
+		for(int i = 0; i < length; i++)
+		{
+			hash ^= (uint8)text[i];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
 	/** Add a named item to the dictionary.
-	 
+
 	 @param name	The name of the object to add.
-	 @param obj		The pointer to associate with the name. 
+	 @param obj		The pointer to associate with the name.
 	 @return		0 if the name was added to the dictionary or the old object
 					if this name was already in the dictionary. */
 	ObjectType* add(String const& name, ObjectType* obj)
 	{
-		int index = ids.indexOf(name);
-		
-		if(index >= 0)
+		return add(name, hashName(name), obj);
+	}
+
+	/** Add a named item to the dictionary using a precomputed hash from hashName(). */
+	ObjectType* add(String const& name, uint32 hash, ObjectType* obj)
+	{
+		if((numUsed + 1) * 4 > capacity * 3)
+			resize(capacity == 0 ? 16 : capacity * 2);
+
+		const char* text = (const char*)name.toUTF8();
+		const int length = (int)strlen(text);
+		Slot& slot = slots[findSlot(text, length, hash)];
+
+		if(slot.used)
 		{
-			ObjectType* oldObj = objects[index];
-			objects.set(index, obj);
+			ObjectType* oldObj = slot.object;
+			slot.object = obj;
 			return oldObj;
 		}
 		else
 		{
-			ids.add(name);
-			objects.add(obj);
+			slot.name = name;
+			slot.length = length;
+			slot.hash = hash;
+			slot.object = obj;
+			slot.used = true;
+			numUsed++;
 			return 0;
 		}
 	}
-	
+
 	/** Returns a named object from the dictionary. */
-	ObjectType* get(String const& name)
+	ObjectType* get(String const& name) const
+	{
+		return get(name, hashName(name));
+	}
+
+	/** Returns a named object from the dictionary using a precomputed hash from hashName(). */
+	ObjectType* get(String const& name, uint32 hash) const
 	{
-		int index = ids.indexOf(name);
-		return objects[index];
+		const char* text = (const char*)name.toUTF8();
+		return get(text, (int)strlen(text), hash);
+	}
+
+	/** Returns an object from the dictionary whose name is given as UTF-8 characters
+	 (which needn't be null terminated) and a hash from hashName(text, length). */
+	ObjectType* get(const char* text, int length, uint32 hash) const
+	{
+		if(numUsed == 0)
+			return 0;
+
+		const Slot& slot = slots[findSlot(text, length, hash)];
+		return slot.used ? slot.object : 0;
 	}
-	
+
 	/** Removes and returns a named object from the dictionary. */
 	ObjectType* remove(String const& name)
 	{
-		int index = ids.indexOf(name);
-		
-		if(index >= 0)
-		{
-			ObjectType* object = objects[index];
-			ids.remove(index);
-			objects.remove(index);
-			return object;
-		}
-		else
-		{
+		return remove(name, hashName(name));
+	}
+
+	/** Removes and returns a named object from the dictionary using a precomputed hash from hashName(). */
+	ObjectType* remove(String const& name, uint32 hash)
+	{
+		if(numUsed == 0)
+			return 0;
+
+		const char* text = (const char*)name.toUTF8();
+		int index = findSlot(text, (int)strlen(text), hash);
+
+		if(!slots[index].used)
 			return 0;
+
+		ObjectType* object = slots[index].object;
+
+		// backward-shift deletion: pull later entries of the probe sequence
+		// into the hole so lookups never need tombstones
+		const int mask = capacity - 1;
+		int hole = index;
+		int next = (hole + 1) & mask;
+
+		while(slots[next].used)
+		{
+			int home = (int)(slots[next].hash & (uint32)mask);
+
+			// move the entry if its home position isn't cyclically within (hole, next]
+			if(((next - home) & mask) >= ((next - hole) & mask))
+			{
+				slots[hole] = slots[next];
+				hole = next;
+			}
+
+			next = (next + 1) & mask;
 		}
+
+		slots[hole] = Slot();
+		numUsed--;
+		return object;
 	}
-	
+
+	/** Returns the number of objects in the dictionary. */
+	int size() const { return numUsed; }
+
 	/** Clears the dictionary. */
 	void clear()
 	{
-		ids.clear();
-		objects.clear();
+		for(int i = 0; i < capacity; i++)
+			slots[i] = Slot();
+
+		numUsed = 0;
 	}
-    
+
+	/** Clears the dictionary and deletes all the objects it contained. */
     void clearAndDelete()
 	{
-		ids.clear();
-        
-        for (int i = 0; i < objects.size(); i++)
-            delete objects[i];
-        
-		objects.clear();
+		for(int i = 0; i < capacity; i++)
+		{
+			if(slots[i].used)
+				delete slots[i].object;
+
+			slots[i] = Slot();
+		}
+
+		numUsed = 0;
+	}
+
+private:
+	/** Returns the index of the slot holding this key, or of the empty slot
+	 where it would be inserted. There must be at least one empty slot. */
+	int findSlot(const char* text, int length, uint32 hash) const
+	{
+		const int mask = capacity - 1;
+		int index = (int)(hash & (uint32)mask);
+
+		while(slots[index].used)
+		{
+			const Slot& slot = slots[index];
+
+			if(slot.hash == hash
+			   && slot.length == length
+			   && memcmp((const char*)slot.name.toUTF8(), text, length) == 0)
+				return index;
+
+			index = (index + 1) & mask;
+		}
+
+		return index;
+	}
+
+	void resize(int newCapacity)
+	{
+		Slot* oldSlots = slots;
+		int oldCapacity = capacity;
+
+		slots = new Slot[newCapacity];
+		capacity = newCapacity;
+
+		for(int i = 0; i < oldCapacity; i++)
+		{
+			if(oldSlots[i].used)
+				slots[findSlot((const char*)oldSlots[i].name.toUTF8(), oldSlots[i].length, oldSlots[i].hash)] = oldSlots[i];
+		}
+
+		delete[] oldSlots;
 	}
 
-	
+	PointerDictionary(const PointerDictionary&);
+	PointerDictionary& operator=(const PointerDictionary&);
 };
 
-#endif // POINTERDICTIONARY_H
\ No newline at end of file
+#endif // POINTERDICTIONARY_H
@@ -0,0 +1,268 @@
+#ifndef REVERBZONES_H
+#define REVERBZONES_H
+
+#include "SpatialGrid.h"
+
+/** Any number of 3D reverb zones sharing a small pool of EventReverbs.
+
+ Each zone is a position, a min and max distance (as for
+ EventReverb::set3DAttributes()) and one of a few reverb presets, e.g., a
+ room's properties. The zones are kept in a SpatialGrid and once per tick
+ update() finds those the listener is within earshot of and gives the
+ EventReverbs to the nearest of them, measured from the edge of each zone's
+ min distance (where the reverb is at full strength). The other zones have no
+ EventReverb, so however many zones a map has FMOD only has the pool's
+ reverbs to mix, and a reverb the listener can't hear is switched off.
+
+ FMOD calls are only made when a zone gains or loses its EventReverb (or is
+ moved while it has one), not every tick.
+
+ Zones are identified by a key chosen by the caller, a small non-negative
+ int such as an object handle. Setting a zone again moves it.
+ */
+class ReverbZones
+{
+public:
+	enum { maxPresets = 8 };
+
+	ReverbZones()
+	:	eventsystem(0),
+		grid(16.0f, 256),		// metres, about the size of a zone
+		largestRange(0)
+	{
+	}
+
+	/** Creates the pool of EventReverbs, all switched off.
+	 Call before update(), and clear() before the EventSystem is released. */
+	void setEventSystem(EventSystem* system, int numReverbs)
+	{
+		clear();
+		eventsystem = system;
+
+		for(int i = 0; i < numReverbs; i++)
+		{
+			EventReverb* reverb;
+			ERRCHECK(eventsystem->createReverb(&reverb));
+			ERRCHECK(reverb->setActive(false));
+
+			reverbs.add(reverb);
+			reverbZones.add(-1);
+		}
+	}
+
+	/** Sets the properties of a preset used by setZone(). */
+	void setPreset(int preset, FMOD_REVERB_PROPERTIES const& properties)
+	{
+		jassert(isPositiveAndBelow(preset, (int)maxPresets));
+		presets[preset] = properties;
+	}
+
+	/** Adds a zone, or moves it if the key has been used before.
+	 @param key				The zone's key.
+	 @param preset			The index of the preset given to setPreset().
+	 @param pos				The centre of the zone.
+	 @param minDistance		The reverb is at full strength within this distance.
+	 @param maxDistance		The reverb can't be heard beyond this distance. */
+	void setZone(int key, int preset, Vector3 const& pos, float minDistance, float maxDistance)
+	{
+		jassert(key >= 0 && isPositiveAndBelow(preset, (int)maxPresets));
+
+		while(zones.size() <= key)
+		{
+			Zone unused;
+			unused.used = false;
+			unused.reverb = -1;
+			zones.add(unused);
+		}
+
+		Zone& zone = zones.getReference(key);
+		const bool presetChanged = zone.used && zone.preset != preset;
+
+		zone.pos = pos;
+		zone.minDistance = minDistance;
+		zone.maxDistance = maxDistance;
+		zone.preset = preset;
+		zone.used = true;
+
+		grid.insert(key, pos);
+		largestRange = jmax(largestRange, maxDistance);
+
+		if(zone.reverb >= 0)
+		{
+			EventReverb* reverb = reverbs.getUnchecked(zone.reverb);
+
+			if(presetChanged)
+				ERRCHECK(reverb->setProperties(&presets[preset]));
+
+			ERRCHECK(reverb->set3DAttributes(&zone.pos, zone.minDistance, zone.maxDistance));
+		}
+	}
+
+	/** Removes a zone, switching its EventReverb off. Unknown keys are ignored. */
+	void removeZone(int key)
+	{
+		if(!isPositiveAndBelow(key, zones.size()) || !zones.getReference(key).used)
+			return;
+
+		Zone& zone = zones.getReference(key);
+
+		if(zone.reverb >= 0)
+			freeReverb(zone.reverb);
+
+		zone.used = false;
+		grid.remove(key);
+	}
+
+	/** Gives the pool's EventReverbs to the zones nearest the listener.
+	 Call once per tick before EventSystem::update(). */
+	void update(Vector3 const& listener)
+	{
+		if(reverbs.size() == 0)
+			return;
+
+		nearby.clearQuick();
+		grid.findWithin(listener, largestRange, nearby);
+
+		// the nearest audible zones, as many as there are reverbs, sorted by distance
+		nearest.clearQuick();
+		nearestDistances.clearQuick();
+
+		for(int i = 0; i < nearby.size(); i++)
+		{
+			const int key = nearby.getUnchecked(i);
+			const Zone& zone = zones.getReference(key);
+			const float distance = getDistance(zone.pos, listener);
+
+			if(distance > zone.maxDistance)
+				continue;
+
+			const float fromEdge = distance - zone.minDistance;
+			int insertAt = nearest.size();
+
+			while(insertAt > 0 && nearestDistances.getUnchecked(insertAt - 1) > fromEdge)
+				insertAt--;
+
+			if(insertAt >= reverbs.size())
+				continue;
+
+			nearest.insert(insertAt, key);
+			nearestDistances.insert(insertAt, fromEdge);
+
+			if(nearest.size() > reverbs.size())
+			{
+				nearest.removeLast();
+				nearestDistances.removeLast();
+			}
+		}
+
+		// take the reverbs from the zones which are no longer among the nearest
+		for(int i = 0; i < reverbs.size(); i++)
+		{
+			const int key = reverbZones.getUnchecked(i);
+
+			if(key >= 0 && !nearest.contains(key))
+				freeReverb(i);
+		}
+
+		// ..and give them to the zones which have just become so
+		for(int i = 0; i < nearest.size(); i++)
+		{
+			const int key = nearest.getUnchecked(i);
+
+			if(zones.getReference(key).reverb < 0)
+				assignReverb(key, reverbZones.indexOf(-1));
+		}
+	}
+
+	/** The number of zones which have an EventReverb. */
+	int getNumActive() const
+	{
+		int numActive = 0;
+
+		for(int i = 0; i < reverbZones.size(); i++)
+			numActive += reverbZones.getUnchecked(i) >= 0 ? 1 : 0;
+
+		return numActive;
+	}
+
+	/** Removes all the zones. */
+	void clearZones()
+	{
+		for(int i = 0; i < reverbs.size(); i++)
+		{
+			if(reverbZones.getUnchecked(i) >= 0)
+				freeReverb(i);
+		}
+
+		zones.clearQuick();
+		grid.clear();
+		largestRange = 0;
+	}
+
+	/** Removes all the zones and releases the EventReverbs, call before the EventSystem is released. */
+	void clear()
+	{
+		clearZones();
+
+		for(int i = 0; i < reverbs.size(); i++)
+			ERRCHECK(reverbs.getUnchecked(i)->release());
+
+		reverbs.clear();
+		reverbZones.clear();
+		eventsystem = 0;
+	}
+
+private:
+	struct Zone
+	{
+		Vector3 pos;
+		float minDistance, maxDistance;
+		int preset;
+		int reverb;		// the index in reverbs, or -1 if the zone has none
+		bool used;
+	};
+
+	EventSystem* eventsystem;
+	FMOD_REVERB_PROPERTIES presets[maxPresets];
+	Array<Zone> zones;				// indexed by key
+	Array<EventReverb*> reverbs;
+	Array<int> reverbZones;			// the key of the zone using each reverb, or -1
+	SpatialGrid grid;
+	float largestRange;				// the largest max distance of any zone
+	Array<int> nearby, nearest;		// used by update()
+	Array<float> nearestDistances;
+
+	static float getDistance(Vector3 const& a, Vector3 const& b)
+	{
+		const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+
+	void assignReverb(int key, int reverbIndex)
+	{
+		jassert(reverbIndex >= 0);
+
+		Zone& zone = zones.getReference(key);
+		EventReverb* reverb = reverbs.getUnchecked(reverbIndex);
+
+		ERRCHECK(reverb->setProperties(&presets[zone.preset]));
+		ERRCHECK(reverb->set3DAttributes(&zone.pos, zone.minDistance, zone.maxDistance));
+		ERRCHECK(reverb->setActive(true));
+
+		zone.reverb = reverbIndex;
+		reverbZones.set(reverbIndex, key);
+	}
+
+	void freeReverb(int reverbIndex)
+	{
+		ERRCHECK(reverbs.getUnchecked(reverbIndex)->setActive(false));
+
+		zones.getReference(reverbZones.getUnchecked(reverbIndex)).reverb = -1;
+		reverbZones.set(reverbIndex, -1);
+	}
+
+	ReverbZones(const ReverbZones&);
+	ReverbZones& operator=(const ReverbZones&);
+};
+
+#endif // REVERBZONES_H
@@ -0,0 +1,146 @@
+#include "headers.h"
+#include "SocketPoller.h"
+
+#if JUCE_LINUX
+ #include <sys/epoll.h>
+ #include <unistd.h>
+#elif JUCE_WINDOWS
+ #include <winsock2.h>
+ typedef WSAPOLLFD PollFd;
+ #define pollSockets WSAPoll
+#else
+ #include <poll.h>
+ typedef struct pollfd PollFd;
+ #define pollSockets poll
+#endif
+
+#if JUCE_LINUX
+
+SocketPoller::SocketPoller()
+:	epollHandle(epoll_create(64))
+{
+	jassert(epollHandle >= 0);
+}
+
+SocketPoller::~SocketPoller()
+{
+	if(epollHandle >= 0)
+		close(epollHandle);
+}
+
+void SocketPoller::add(int socketHandle, void* userData)
+{
+	epoll_event event;
+	zerostruct(event);
+	event.events = EPOLLIN;
+	event.data.ptr = userData;
+
+	epoll_ctl(epollHandle, EPOLL_CTL_ADD, socketHandle, &event);
+}
+
+void SocketPoller::remove(int socketHandle)
+{
+	epoll_event event;	// ignored, but older kernels need it to be non-null
+	zerostruct(event);
+
+	epoll_ctl(epollHandle, EPOLL_CTL_DEL, socketHandle, &event);
+}
+
+int SocketPoller::wait(int timeoutMs, void** ready, int maxReady)
+{
+	const int maxEvents = 64;
+	epoll_event events[maxEvents];
+
+	const int numEvents = epoll_wait(epollHandle, events, jmin(maxReady, maxEvents), timeoutMs);
+
+	for(int i = 0; i < numEvents; i++)
+		ready[i] = events[i].data.ptr;
+
+	return jmax(0, numEvents);
+}
+
+#else
+
+SocketPoller::SocketPoller()
+:	pollDataSize(0),
+	entriesChanged(false)
+{
+}
+
+SocketPoller::~SocketPoller()
+{
+}
+
+void SocketPoller::add(int socketHandle, void* userData)
+{
+	Entry entry;
+	entry.socketHandle = socketHandle;
+	entry.userData = userData;
+
+	entries.add(entry);
+	entriesChanged = true;
+}
+
+void SocketPoller::remove(int socketHandle)
+{
+	for(int i = 0; i < entries.size(); i++)
+	{
+		if(entries.getReference(i).socketHandle == socketHandle)
+		{
+			entries.remove(i);
+			entriesChanged = true;
+			return;
+		}
+	}
+}
+
+int SocketPoller::wait(int timeoutMs, void** ready, int maxReady)
+{
+	const int numEntries = entries.size();
+
+	if(entriesChanged)
+	{
+		if(pollDataSize < numEntries)
+		{
+			pollDataSize = jmax(16, numEntries * 2);
+			pollData.malloc(pollDataSize * sizeof(PollFd));
+		}
+
+		PollFd* fds = (PollFd*)pollData.getData();
+
+		for(int i = 0; i < numEntries; i++)
+		{
+			zerostruct(fds[i]);
+			fds[i].fd = entries.getReference(i).socketHandle;
+			fds[i].events = POLLIN;
+		}
+
+		entriesChanged = false;
+	}
+
+	if(numEntries == 0)
+	{
+		Thread::sleep(timeoutMs);
+		return 0;
+	}
+
+	PollFd* fds = (PollFd*)pollData.getData();
+
+	if(pollSockets(fds, numEntries, timeoutMs) <= 0)
+		return 0;
+
+	int numReady = 0;
+
+	for(int i = 0; i < numEntries && numReady < maxReady; i++)
+	{
+		// a closed or failed socket is reported as ready so that the read finds out
+		if(fds[i].revents != 0)
+			ready[numReady++] = entries.getReference(i).userData;
+
+		fds[i].revents = 0;
+	}
+
+	return numReady;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SOCKETPOLLER_H
+#define SOCKETPOLLER_H
+
+#include <juce/juce.h>
+
+/** Waits for any of a set of sockets to have data to read.
+
+ Uses epoll on Linux and poll() elsewhere (WSAPoll() on Windows), so one
+ thread can serve many connections without asking each socket in turn. Each
+ socket is registered with a pointer which is handed back when it's ready.
+ */
+class SocketPoller
+{
+public:
+	SocketPoller();
+	~SocketPoller();
+
+	/** Starts watching a socket (from StreamingSocket::getRawSocketHandle()). */
+	void add(int socketHandle, void* userData);
+
+	/** Stops watching a socket, call before the socket is closed. */
+	void remove(int socketHandle);
+
+	/** Waits until at least one socket can be read or the timeout passes.
+	 @param timeoutMs	How long to wait in milliseconds.
+	 @param ready		Filled with the userData of each socket which can be read.
+	 @param maxReady	The size of the ready array.
+	 @return The number of entries filled in ready, 0 on a timeout or an error. */
+	int wait(int timeoutMs, void** ready, int maxReady);
+
+private:
+#if JUCE_LINUX
+	int epollHandle;
+#else
+	struct Entry
+	{
+		int socketHandle;
+		void* userData;
+	};
+
+	Array<Entry> entries;
+	HeapBlock<char> pollData;	// the platform's pollfd array, rebuilt when entries change
+	int pollDataSize;
+	bool entriesChanged;
+#endif
+
+	SocketPoller(const SocketPoller&);
+	SocketPoller& operator=(const SocketPoller&);
+};
+
+#endif // SOCKETPOLLER_H
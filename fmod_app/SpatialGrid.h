@@ -0,0 +1,223 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <juce/juce.h>
+
+/** A uniform grid over the positions of numbered items, for finding the items near a point.
+
+ Space is divided into cubic cells and each item is kept in the bucket of the
+ cell its position is in. The cells are hashed onto a fixed number of buckets
+ so the grid has no bounds and its memory doesn't depend on the size of the
+ map; cells which share a bucket are told apart by the distance test.
+
+ Moving an item only touches the buckets when it crosses into a cell which
+ hashes to a different bucket, so objects which move a little every tick cost
+ a few multiplies. findWithin() visits only the cells overlapping the query's
+ bounding box, or every bucket if that would be fewer.
+
+ Items are numbered from 0, e.g., the slots of an ObjectStore.
+ */
+class SpatialGrid
+{
+public:
+	/** @param cellSize		The width of a cell, roughly the range of the usual query works well.
+	 @param numBuckets		The number of buckets, a power of two. */
+	SpatialGrid(float cellSize, int numBuckets = 1024)
+	:	cellScale(1.0f / cellSize),
+		numItems(0)
+	{
+		jassert(cellSize > 0 && numBuckets > 0 && (numBuckets & (numBuckets - 1)) == 0);
+
+		for(int i = 0; i < numBuckets; i++)
+			buckets.add(new Array<int>());
+	}
+
+	/** Adds an item, or moves it if it's already in the grid. */
+	void insert(int item, Vector3 const& pos)
+	{
+		while(items.size() <= item)
+		{
+			Item empty;
+			empty.bucket = -1;
+			empty.index = -1;
+			items.add(empty);
+		}
+
+		if(items.getReference(item).bucket >= 0)
+		{
+			move(item, pos);
+			return;
+		}
+
+		Item& entry = items.getReference(item);
+		entry.pos = pos;
+		addToBucket(item, getBucket(pos));
+		numItems++;
+	}
+
+	/** Updates an item's position. Items which aren't in the grid are ignored. */
+	void move(int item, Vector3 const& pos)
+	{
+		if(!contains(item))
+			return;
+
+		Item& entry = items.getReference(item);
+		entry.pos = pos;
+
+		const int bucket = getBucket(pos);
+
+		if(bucket != entry.bucket)
+		{
+			removeFromBucket(item);
+			addToBucket(item, bucket);
+		}
+	}
+
+	/** Takes an item out of the grid. Items which aren't in the grid are ignored. */
+	void remove(int item)
+	{
+		if(!contains(item))
+			return;
+
+		removeFromBucket(item);
+		items.getReference(item).bucket = -1;
+		numItems--;
+	}
+
+	void clear()
+	{
+		for(int i = 0; i < buckets.size(); i++)
+			buckets.getUnchecked(i)->clearQuick();
+
+		items.clearQuick();
+		numItems = 0;
+	}
+
+	bool contains(int item) const
+	{
+		return isPositiveAndBelow(item, items.size()) && items.getReference(item).bucket >= 0;
+	}
+
+	int getNumItems() const { return numItems; }
+
+	/** The position an item was last given. */
+	Vector3 const& getPosition(int item) const { return items.getReference(item).pos; }
+
+	/** Appends the items within a distance of a point to an array, in no particular order.
+	 The array isn't cleared first. */
+	void findWithin(Vector3 const& centre, float radius, Array<int>& results) const
+	{
+		if(numItems == 0)
+			return;
+
+		const float radiusSquared = radius * radius;
+		const int x0 = getCell(centre.x - radius), x1 = getCell(centre.x + radius);
+		const int y0 = getCell(centre.y - radius), y1 = getCell(centre.y + radius);
+		const int z0 = getCell(centre.z - radius), z1 = getCell(centre.z + radius);
+		const double numCells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1) * ((double)z1 - z0 + 1);
+
+		if(numCells >= buckets.size())
+		{
+			for(int i = 0; i < buckets.size(); i++)
+				addWithin(*buckets.getUnchecked(i), centre, radiusSquared, results);
+
+			return;
+		}
+
+		for(int x = x0; x <= x1; x++)
+			for(int y = y0; y <= y1; y++)
+				for(int z = z0; z <= z1; z++)
+				{
+					// a bucket may also hold items of other cells, those are
+					// skipped here and found when their own cell comes round
+					const int bucket = hashCell(x, y, z);
+					const Array<int>& bucketItems = *buckets.getUnchecked(bucket);
+
+					for(int i = 0; i < bucketItems.size(); i++)
+					{
+						const int item = bucketItems.getUnchecked(i);
+						const Vector3& pos = items.getReference(item).pos;
+
+						if(getCell(pos.x) == x && getCell(pos.y) == y && getCell(pos.z) == z
+						   && distanceSquared(pos, centre) <= radiusSquared)
+							results.add(item);
+					}
+				}
+	}
+
+private:
+	struct Item
+	{
+		Vector3 pos;
+		int bucket;		// -1 if the item isn't in the grid
+		int index;		// in its bucket
+	};
+
+	const float cellScale;
+	OwnedArray< Array<int> > buckets;
+	Array<Item> items;
+	int numItems;
+
+	int getCell(float coordinate) const
+	{
+		// clamped so that far away (or infinite) positions still land in a cell
+		const float cell = jlimit(-1.0e9f, 1.0e9f, coordinate * cellScale);
+		return (int)floorf(cell);
+	}
+
+	int hashCell(int x, int y, int z) const
+	{
+		const uint32 hash = ((uint32)x * 73856093u) ^ ((uint32)y * 19349663u) ^ ((uint32)z * 83492791u);
+		return (int)((hash ^ (hash >> 16)) & (uint32)(buckets.size() - 1));
+	}
+
+	int getBucket(Vector3 const& pos) const
+	{
+		return hashCell(getCell(pos.x), getCell(pos.y), getCell(pos.z));
+	}
+
+	static float distanceSquared(Vector3 const& a, Vector3 const& b)
+	{
+		const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	void addWithin(const Array<int>& bucketItems, Vector3 const& centre, float radiusSquared, Array<int>& results) const
+	{
+		for(int i = 0; i < bucketItems.size(); i++)
+		{
+			const int item = bucketItems.getUnchecked(i);
+
+			if(distanceSquared(items.getReference(item).pos, centre) <= radiusSquared)
+				results.add(item);
+		}
+	}
+
+	void addToBucket(int item, int bucket)
+	{
+		Array<int>& bucketItems = *buckets.getUnchecked(bucket);
+		Item& entry = items.getReference(item);
+		entry.bucket = bucket;
+		entry.index = bucketItems.size();
+		bucketItems.add(item);
+	}
+
+	/** Swaps the last item of the bucket into the item's place. */
+	void removeFromBucket(int item)
+	{
+		const Item& entry = items.getReference(item);
+		Array<int>& bucketItems = *buckets.getUnchecked(entry.bucket);
+		const int last = bucketItems.getLast();
+
+		bucketItems.set(entry.index, last);
+		bucketItems.removeLast();
+
+		if(last != item)
+			items.getReference(last).index = entry.index;
+	}
+
+	SpatialGrid(const SpatialGrid&);
+	SpatialGrid& operator=(const SpatialGrid&);
+};
+
+#endif // SPATIALGRID_H
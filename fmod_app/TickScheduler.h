@@ -0,0 +1,151 @@
+#ifndef TICKSCHEDULER_H
+#define TICKSCHEDULER_H
+
+#include <juce/juce.h>
+#include "Histogram.h"
+
+/** Paces a thread's ticks against fixed deadlines on the monotonic high resolution clock.
+
+ Each deadline is the previous deadline plus one period, not the time the
+ previous tick happened to run plus one period, so lateness doesn't build up
+ into drift. The thread sleeps until just before the deadline and then
+ yields for the last fraction of a millisecond, which the sleep can't time.
+
+ When a tick is late by more than a whole period the LatePolicy decides what
+ happens to the ticks which were missed: skip moves the deadline on to the
+ next one in the future (the missed ticks are counted), catchUp runs them
+ back to back, up to maxCatchUpTicks, before falling back to skipping.
+
+ How late each tick runs and the interval between ticks are recorded in
+ Histograms, in microseconds. These are written by the ticking thread so read
+ them on that thread (e.g., from tick()).
+ */
+class TickScheduler
+{
+public:
+	enum LatePolicy
+	{
+		skip,		///< drop missed ticks and wait for the next deadline
+		catchUp		///< run missed ticks straight away
+	};
+
+	enum { maxCatchUpTicks = 4 };
+
+	TickScheduler(double ticksPerSecond, LatePolicy policy = skip)
+	:	latePolicy(policy),
+		nextDeadline(0),
+		lastTickTime(0),
+		numSkippedTicks(0)
+	{
+		setRate(ticksPerSecond);
+	}
+
+	/** Sets the target rate, e.g., 60, 120 or 240 ticks per second. Takes effect from the next tick. */
+	void setRate(double ticksPerSecond)
+	{
+		jassert(ticksPerSecond > 0);
+		period = jmax((int64)1, Time::secondsToHighResolutionTicks(1.0 / ticksPerSecond));
+	}
+
+	double getRate() const { return 1.0 / Time::highResolutionTicksToSeconds(period); }
+
+	void setLatePolicy(LatePolicy policy) { latePolicy = policy; }
+	LatePolicy getLatePolicy() const { return latePolicy; }
+
+	/** Waits until the next tick is due.
+	 @param thread	The calling thread, whose notify() or signalThreadShouldExit() ends the wait early.
+	 @return false if the thread should exit rather than tick. */
+	bool waitForNextTick(Thread& thread)
+	{
+		if(nextDeadline == 0)
+			nextDeadline = Time::getHighResolutionTicks() + period;
+
+		const int64 ticksPerMs = jmax((int64)1, Time::secondsToHighResolutionTicks(0.001));
+
+		for(;;)
+		{
+			if(thread.threadShouldExit())
+				return false;
+
+			const int64 remaining = nextDeadline - Time::getHighResolutionTicks();
+
+			if(remaining <= 0)
+				break;
+
+			// sleep for the whole milliseconds then yield until the deadline itself
+			if(remaining > ticksPerMs)
+				thread.wait((int)(remaining / ticksPerMs));
+			else
+				Thread::yield();
+		}
+
+		const int64 now = Time::getHighResolutionTicks();
+		lateness.add(Histogram::ticksToMicroseconds(now - nextDeadline));
+
+		if(lastTickTime != 0)
+			intervals.add(Histogram::ticksToMicroseconds(now - lastTickTime));
+
+		lastTickTime = now;
+		nextDeadline += period;
+
+		if(now >= nextDeadline)
+		{
+			// the next deadline has passed already, so at least one tick was missed
+			const int64 missed = (now - nextDeadline) / period + 1;
+
+			if(latePolicy == skip || missed > maxCatchUpTicks)
+			{
+				numSkippedTicks += (int)missed;
+				nextDeadline += missed * period;
+			}
+		}
+
+		return true;
+	}
+
+	/** Starts the deadlines afresh from the next wait.
+	 Call this when the thread has been idle, so the time it spent idle isn't counted as late or skipped ticks. */
+	void restart()
+	{
+		nextDeadline = 0;
+		lastTickTime = 0;
+	}
+
+	/** How late each tick ran after its deadline, in microseconds. */
+	Histogram const& getLateness() const { return lateness; }
+
+	/** The time between the starts of consecutive ticks, in microseconds. */
+	Histogram const& getIntervals() const { return intervals; }
+
+	/** The number of ticks dropped because they were missed. */
+	int getNumSkippedTicks() const { return numSkippedTicks; }
+
+	/** Returns a one line summary of the histograms and skipped ticks. */
+	String getSummary() const
+	{
+		return "late(us) " + lateness.getSummary()
+			+ ", interval(us) " + intervals.getSummary()
+			+ ", skipped " + String(numSkippedTicks);
+	}
+
+	/** Clears the histograms and the skipped tick count. */
+	void clearStats()
+	{
+		lateness.clear();
+		intervals.clear();
+		numSkippedTicks = 0;
+	}
+
+private:
+	LatePolicy latePolicy;
+	int64 period;			// in high resolution ticks
+	int64 nextDeadline;		// 0 until the first wait
+	int64 lastTickTime;
+	Histogram lateness, intervals;
+	int numSkippedTicks;
+
+	TickScheduler(const TickScheduler&);
+	TickScheduler& operator=(const TickScheduler&);
+};
+
+#endif // TICKSCHEDULER_H
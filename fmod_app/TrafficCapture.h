@@ -0,0 +1,152 @@
+#ifndef TRAFFICCAPTURE_H
+#define TRAFFICCAPTURE_H
+
+#include <juce/juce.h>
+
+/** The file format used by ConnectionServer to capture and replay network traffic.
+
+ A capture file is the 8 byte magic "GCAPTUR1" followed by records, each a
+ 16 byte header and then the bytes exactly as they were read from the socket:
+
+ <table>
+ <tr><td>8 bytes</td><td>microseconds since the capture started</td></tr>
+ <tr><td>4 bytes</td><td>the number of bytes after the header</td></tr>
+ <tr><td>2 bytes</td><td>client ID</td></tr>
+ <tr><td>1 byte</td><td>record type (see RecordType)</td></tr>
+ <tr><td>1 byte</td><td>unused, 0</td></tr>
+ </table>
+
+ Numbers are little endian. Reads are captured rather than parsed messages, so
+ a replay splits the stream in the same places as the original session did.
+ Nothing is compressed or indexed, the file is only ever appended to and can
+ be read in place (e.g., memory mapped). Appending a second session restarts
+ the times from 0.
+ */
+namespace TrafficCapture
+{
+	static const char magic[8] = { 'G', 'C', 'A', 'P', 'T', 'U', 'R', '1' };
+
+	enum { headerSize = 16 };
+
+	enum RecordType
+	{
+		clientOpened = 1,	///< no bytes
+		clientClosed,		///< no bytes
+		clientData,			///< bytes read from a client's TCP connection
+		datagram			///< a whole UDP datagram, the client ID is 0
+	};
+
+	/** One record, pointing into the Reader's data. */
+	struct Record
+	{
+		int64 time;			// microseconds
+		int clientId;
+		RecordType type;
+		const uint8* data;
+		int size;
+	};
+
+	/** Appends records to a capture file. */
+	class Writer
+	{
+	public:
+		Writer(File const& file)
+		:	stream(file, 65536),
+			startTime(Time::getHighResolutionTicks())
+		{
+			if(!stream.failedToOpen() && stream.getPosition() == 0)
+				stream.write(magic, sizeof(magic));
+		}
+
+		bool openedOk() const { return !stream.failedToOpen(); }
+
+		void write(RecordType type, int clientId, const void* data, int size)
+		{
+			const uint64 time = (uint64)(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTime) * 1000000.0);
+
+			uint8 header[headerSize];
+
+			for(int i = 0; i < 8; i++)
+				header[i] = (uint8)(time >> (i * 8));
+
+			for(int i = 0; i < 4; i++)
+				header[8 + i] = (uint8)((uint32)size >> (i * 8));
+
+			header[12] = (uint8)clientId;
+			header[13] = (uint8)(clientId >> 8);
+			header[14] = (uint8)type;
+			header[15] = 0;
+
+			stream.write(header, headerSize);
+
+			if(size > 0)
+				stream.write(data, size);
+		}
+
+	private:
+		FileOutputStream stream;
+		int64 startTime;
+
+		Writer(const Writer&);
+		Writer& operator=(const Writer&);
+	};
+
+	/** Reads the records of a capture file in order. */
+	class Reader
+	{
+	public:
+		Reader(File const& file)
+		:	position(0),
+			valid(false)
+		{
+			if(file.loadFileAsData(data) && data.getSize() >= sizeof(magic)
+			   && memcmp(data.getData(), magic, sizeof(magic)) == 0)
+			{
+				position = sizeof(magic);
+				valid = true;
+			}
+		}
+
+		/** False if the file couldn't be read or isn't a capture. */
+		bool isValid() const { return valid; }
+
+		/** The total size of the file in bytes. */
+		int64 getSize() const { return (int64)data.getSize(); }
+
+		/** Reads the next record.
+		 @return false at the end of the file (or at a record cut short by a crash). */
+		bool next(Record& record)
+		{
+			const uint8* bytes = (const uint8*)data.getData();
+			const size_t size = data.getSize();
+
+			if(!valid || position + headerSize > size)
+				return false;
+
+			const uint8* header = bytes + position;
+			const uint32 recordSize = ByteOrder::littleEndianInt(header + 8);
+
+			if(recordSize > size - position - headerSize)
+				return false;
+
+			record.time = (int64)ByteOrder::littleEndianInt64(header);
+			record.clientId = header[12] | (header[13] << 8);
+			record.type = (RecordType)header[14];
+			record.data = header + headerSize;
+			record.size = (int)recordSize;
+
+			position += headerSize + recordSize;
+			return true;
+		}
+
+	private:
+		MemoryBlock data;
+		size_t position;
+		bool valid;
+
+		Reader(const Reader&);
+		Reader& operator=(const Reader&);
+	};
+}
+
+#endif // TRAFFICCAPTURE_H
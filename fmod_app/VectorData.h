@@ -9,87 +9,87 @@
 #ifndef shooter_VectorData_h
 #define shooter_VectorData_h
 
-/** Keep track of the vector data for a game object.
- This also keeps an array of Events that are already playing at
- this object's position and automatically updates the 3D attributes
- when the object moves. It also removes the Event from the array
- when the Event has finished playing. Functions are provided to start,
+#include "ObjectStore.h"
+
+/** Access to the vector data for a game object held in an ObjectStore.
+ This is a lightweight view (a store and a slot) which is passed around
+ by value; the vectors and the array of Events playing at the object's
+ position live in the store. The Events' 3D attributes are updated when
+ the object moves. Moves are batched: setVectors() only stores the new
+ vectors and the Events are updated once by ObjectStore::flushMoved(),
+ however many vectors arrived in between. Events are removed from the
+ object by ObjectStore::reapFinished() when they have finished playing
+ or been stolen. Functions are provided to start,
  stop and apply "key-off" for a given parameter for all current events.
  You can add more if you need to modify all events.
  */
 class VectorData
 {
 public:
+	/** An invalid view, isValid() returns false. */
 	VectorData()
+	:	store(0),
+		index(-1)
 	{
-		pos.x = pos.y = pos.z = 0;
-		vel.x = vel.y = vel.z = 0;
-		dir.x = dir.y = dir.z = 0;
 	}
-    
-    ~VectorData()
-    {
-        stopEvents();
-    }
 	
-    bool eventIsLive(Event* event)
-    {
-        FMOD_EVENT_STATE state;
-        FMOD_RESULT error = event->getState(&state);
-        
-        if((error == FMOD_OK) && (state & FMOD_EVENT_STATE_PLAYING))
-        {
-            return true;
-        }
-        else
-        {
-            // if you are using Juce modules 2.x this needs to be: events.removeFirstMatchingValue(event)
-            events.removeValue(event); // event has finished playing
-            return false;
-        }
-    }
-    
-	/** Update one or more of the vectors. */
+	VectorData(ObjectStore* objectStore, int slot)
+	:	store(objectStore),
+		index(slot)
+	{
+	}
+	
+	/** False if the object doesn't exist. */
+	bool isValid() const { return store != 0; }
+	
+	/** Update one or more of the vectors.
+	 The Events aren't updated until the store's moves are flushed. */
 	void setVectors(const Vector3 *newPos,
 					const Vector3 *newVel,
 					const Vector3 *newDir)
 	{
-		if(newPos) pos = *newPos;
-		if(newVel) vel = *newVel;
-		if(newDir) dir = *newDir;
-		
-		for(int i = events.size()-1; i >= 0; i--)
-		{
-			Event* event = events[i];
-			
-			if(eventIsLive(event))
-			{
-				ERRCHECK(event->set3DAttributes(newPos,
-												newVel,
-												newDir));
-			}
-		}
+		store->setVectors(index, newPos, newVel, newDir);
 	}
 	
-	const Vector3* getPos() const { return &pos; }
-	const Vector3* getVel() const { return &vel; }
-	const Vector3* getDir() const { return &dir; }
+	const Vector3* getPos() const { return &store->positions.getReference(index); }
+	const Vector3* getVel() const { return &store->velocities.getReference(index); }
+	const Vector3* getDir() const { return &store->directions.getReference(index); }
 	
 	/** Add an Event playing at this object position. */
 	void addEvent(Event* event)
 	{
-		events.add(event);
-		ERRCHECK(event->set3DAttributes(&pos, &vel, &dir));
+		store->attachEvent(index, event);
+		ERRCHECK(event->set3DAttributes(getPos(), getVel(), getDir()));
+		
+		// the object can be culled once the listener is beyond the furthest any of its events can be heard
+		float maxDistance;
+		
+		if(event->getPropertyByIndex(FMOD_EVENTPROPERTY_3D_MAXDISTANCE, &maxDistance) != FMOD_OK)
+			maxDistance = FLT_MAX;
+		
+		if(maxDistance > store->maxDistances[index])
+			store->maxDistances.set(index, maxDistance);
+	}
+	
+	/** Add a looping Event playing at this object position.
+	 The object's Events are paused while the listener is out of earshot
+	 (see ObjectStore::pauseOutOfRange()). */
+	void addLoopingEvent(Event* event)
+	{
+		addEvent(event);
+		store->setLooping(index);
 	}
 	
 	/** Remove an Event manually. */
 	void removeEvent(Event* event)
 	{
-		events.removeValue(event);
+		store->detachEvent(event);
 	}
 	
     void startEvents()
     {
+        Array<Event*>& events = getEvents();
+        
         for(int i = events.size()-1; i >= 0; i--)
 		{
             Event* event = events[i];
@@ -99,52 +99,43 @@ public:
     
     void stopEvents()
     {
-        for(int i = events.size()-1; i >= 0; i--)
-		{
-            Event* event = events[i];
-            
-            if(eventIsLive(event))
-                ERRCHECK(event->stop());
-        }
+        store->stopEvents(index);
     }
     
-    void setParameter(String const& param, const float value)
+    /** Sets a parameter of all current events, skipping those which already have the value.
+     @param param   The index of the parameter's name, see ParameterCache::setNames(). */
+    void setParameter(int param, const float value)
     {
-        const char* paramString = (const char*)param.toUTF8();
+        Array<Event*>& events = getEvents();
         
         for(int i = events.size()-1; i >= 0; i--)
 		{
-            Event* event = events[i];
-            
-            if(eventIsLive(event))
-            {
-                EventParameter* param;
-                ERRCHECK(event->getParameter(paramString, &param));
-                ERRCHECK(param->setValue(value));
-            }
+            if(!store->parameters.setValue(events[i], param, value))
+                jassertfalse;
         }
     }
     
-    void parameterKeyOff(String const& param)
+    /** Keys off a parameter of all current events.
+     @param paramIndex  The index of the parameter's name, see ParameterCache::setNames(). */
+    void parameterKeyOff(int paramIndex)
     {
-        const char* paramString = (const char*)param.toUTF8();
+        Array<Event*>& events = getEvents();
         
         for(int i = events.size()-1; i >= 0; i--)
 		{
-            Event* event = events[i];
+            EventParameter* param = store->parameters.getParameter(events[i], paramIndex);
+            jassert(param != 0);
             
-            if(eventIsLive(event))
-            {
-                EventParameter* param;
-                ERRCHECK(event->getParameter(paramString, &param));
+            if(param != 0)
                 ERRCHECK(param->keyOff());
-            }
         }
     }
     
 private:
-	Vector3 pos, vel, dir;
-	Array<Event*> events;
+	ObjectStore* store;
+	int index;
+	
+	Array<Event*>& getEvents() { return store->events.getReference(index); }
 };
 
 
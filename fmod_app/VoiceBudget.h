@@ -0,0 +1,244 @@
+#ifndef VOICEBUDGET_H
+#define VOICEBUDGET_H
+
+#include "VectorData.h"
+
+/** Decides which one-shot events are worth a voice, in front of Event::start().
+
+ Each sound is scored from its category's priority, how loud it is (e.g., a
+ collision's velocity) and how far it is from the listener:
+ @code
+ score = priority * loudness * referenceDistance / (referenceDistance + distance)
+ @endcode
+ Each category has a limit on how many of its events may play at once, and
+ all the categories together share an overall limit. When a limit is reached
+ the quietest playing event which counts towards it (by score) is stopped to
+ make room, unless it scores higher than the new one, in which case the new
+ one is dropped before anything is asked of FMOD. So in a heavy firefight the
+ near, loud and important sounds play and the rest are lost deliberately
+ rather than wherever FMOD runs out of channels.
+
+ Only events started through start() are counted. Events are forgotten once
+ they've finished, which is checked only when a limit has been reached.
+ */
+class VoiceBudget
+{
+public:
+	enum { maxCategories = 8 };
+
+	/** @param maxVoices			The most events which may play at once over all the categories.
+	 @param referenceDistance	The distance in metres at which a sound's score is halved. */
+	VoiceBudget(int maxVoices = 64, float referenceDistance = 10.0f)
+	:	totalLimit(maxVoices),
+		reference(referenceDistance)
+	{
+		listener.x = listener.y = listener.z = 0;
+		clear();
+	}
+
+	/** Sets the priority of a category and the most of its events which may play at once.
+	 Categories which aren't set have a priority of 1 and only the overall limit. */
+	void setCategory(int category, float priority, int maxVoices)
+	{
+		jassert(isPositiveAndBelow(category, (int)maxCategories));
+
+		categories[category].priority = priority;
+		categories[category].maxVoices = maxVoices;
+	}
+
+	/** Sets where distances are measured from, e.g., once per tick. */
+	void setListener(Vector3 const& listenerPos)
+	{
+		listener = listenerPos;
+	}
+
+	/** Adds the event to the object and starts it, if there's room for it.
+	 @param object		Where the event plays.
+	 @param event		The event, from an EventPool. If it's dropped it goes back to its pool.
+	 @param category	The event's category.
+	 @param loudness	How loud the sound is, from 0 to 1.
+	 @return			false if the event was dropped. */
+	bool start(VectorData& object, Event* event, int category, float loudness = 1.0f)
+	{
+		jassert(isPositiveAndBelow(category, (int)maxCategories));
+
+		Category& eventCategory = categories[category];
+		const float score = getScore(eventCategory, *object.getPos(), loudness);
+
+		// a pooled Event is reused once it has finished
+		const int previous = findVoice(event);
+
+		if(previous >= 0)
+			removeVoice(previous);
+
+		if(isFull(eventCategory))
+		{
+			removeFinished();
+
+			if(isFull(eventCategory))
+			{
+				// make room in the category if that's full, otherwise anywhere
+				const int quietest = findQuietest(eventCategory.numVoices >= eventCategory.maxVoices ? category : -1);
+
+				if(quietest < 0 || voices.getReference(quietest).score >= score)
+				{
+					eventCategory.numDropped++;
+					EventPool::release(event);
+					return false;
+				}
+
+				Voice const& victim = voices.getReference(quietest);
+				categories[victim.category].numStolen++;
+				ERRCHECK(victim.event->stop(true));
+				removeVoice(quietest);
+			}
+		}
+
+		object.addEvent(event);
+		ERRCHECK(event->start());
+
+		Voice voice;
+		voice.event = event;
+		voice.category = category;
+		voice.score = score;
+		voices.add(voice);
+
+		eventCategory.numVoices++;
+		eventCategory.numStarted++;
+		return true;
+	}
+
+	int getNumStarted(int category) const { return categories[category].numStarted; }
+	int getNumDropped(int category) const { return categories[category].numDropped; }
+	int getNumStolen(int category) const { return categories[category].numStolen; }
+
+	int getTotalStarted() const { return getTotal(&Category::numStarted); }
+	int getTotalDropped() const { return getTotal(&Category::numDropped); }
+	int getTotalStolen() const { return getTotal(&Category::numStolen); }
+
+	/** Writes the events started, dropped and stolen in each category to the debug log.
+	 @param names	The name of each category, for the log. */
+	void logStats(const char* const* names, int numNames) const
+	{
+		for(int i = 0; i < jmin(numNames, (int)maxCategories); i++)
+		{
+			Category const& category = categories[i];
+
+			Logger::outputDebugString(String(names[i]) + ": " + String(category.numStarted) + " started, "
+									  + String(category.numDropped) + " dropped, " + String(category.numStolen) + " stolen");
+		}
+
+		Logger::outputDebugString("Voice budget: " + String(getTotalStarted()) + " started, "
+								  + String(getTotalDropped()) + " dropped, " + String(getTotalStolen()) + " stolen");
+	}
+
+	/** Forgets the playing events and the counts, but not the categories' settings.
+	 Call when the EventSystem is released. */
+	void clear()
+	{
+		voices.clear();
+
+		for(int i = 0; i < maxCategories; i++)
+		{
+			categories[i].numVoices = 0;
+			categories[i].numStarted = categories[i].numDropped = categories[i].numStolen = 0;
+		}
+	}
+
+private:
+	struct Category
+	{
+		Category() : priority(1.0f), maxVoices(0x7fffffff) {}
+
+		float priority;
+		int maxVoices;
+		int numVoices;		// playing as far as we know
+		int numStarted, numDropped, numStolen;
+	};
+
+	struct Voice
+	{
+		Event* event;
+		int category;
+		float score;
+	};
+
+	Category categories[maxCategories];
+	Array<Voice> voices;
+	const int totalLimit;
+	const float reference;
+	Vector3 listener;
+
+	bool isFull(Category const& category) const
+	{
+		return category.numVoices >= category.maxVoices || voices.size() >= totalLimit;
+	}
+
+	float getScore(Category const& category, Vector3 const& pos, float loudness) const
+	{
+		const float dx = pos.x - listener.x, dy = pos.y - listener.y, dz = pos.z - listener.z;
+		const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+		return category.priority * jlimit(0.0f, 1.0f, loudness) * reference / (reference + distance);
+	}
+
+	int findVoice(Event* event) const
+	{
+		for(int i = 0; i < voices.size(); i++)
+		{
+			if(voices.getReference(i).event == event)
+				return i;
+		}
+
+		return -1;
+	}
+
+	/** The playing event with the lowest score in a category, or in any category if category is -1. */
+	int findQuietest(int category) const
+	{
+		int quietest = -1;
+
+		for(int i = 0; i < voices.size(); i++)
+		{
+			Voice const& voice = voices.getReference(i);
+
+			if((category < 0 || voice.category == category)
+			   && (quietest < 0 || voice.score < voices.getReference(quietest).score))
+				quietest = i;
+		}
+
+		return quietest;
+	}
+
+	void removeVoice(int index)
+	{
+		categories[voices.getReference(index).category].numVoices--;
+		voices.remove(index);
+	}
+
+	void removeFinished()
+	{
+		for(int i = voices.size()-1; i >= 0; i--)
+		{
+			FMOD_EVENT_STATE state;
+
+			if(voices.getReference(i).event->getState(&state) != FMOD_OK || !(state & FMOD_EVENT_STATE_PLAYING))
+				removeVoice(i);
+		}
+	}
+
+	int getTotal(int Category::*count) const
+	{
+		int total = 0;
+
+		for(int i = 0; i < maxCategories; i++)
+			total += categories[i].*count;
+
+		return total;
+	}
+
+	VoiceBudget(const VoiceBudget&);
+	VoiceBudget& operator=(const VoiceBudget&);
+};
+
+#endif // VOICEBUDGET_H
@@ -18,7 +18,15 @@
 
 // FMOD headers
 
-#if TARGET_OS_IPHONE || TARGET_IPHONE_SIMULATOR // not working yet for this example but could be made to..
+// set FMOD_MOCK to 1 to build against a headless stand-in for FMOD which counts calls
+// rather than playing sounds (e.g., for profiling on a machine without audio hardware)
+#ifndef FMOD_MOCK
+#define FMOD_MOCK 0
+#endif
+
+#if FMOD_MOCK
+#include "MockEventSystem.h"
+#elif TARGET_OS_IPHONE || TARGET_IPHONE_SIMULATOR // not working yet for this example but could be made to..
 #include <fmodiphone/api/inc/fmod.hpp>
 #include <fmodiphone/api/inc/fmod_errors.h>
 #include <fmodiphone/fmoddesignerapi/api/inc/fmod_event.hpp>
@@ -35,7 +43,9 @@
 // not that an extra slash needs to be added for FMOD to recoginse these paths but
 // Juce strips the trailing slash away - so we add it manually later on
 #ifdef JUCE_MAC
+#if !FMOD_MOCK
 #include <fmod/examples/common/wincompat.h>
+#endif
 #define MEDIAPATH "../Resources"
 #else // windows - this is not ideal - a better way would be to create a folder next to the app and copy the files in
 #define MEDIAPATH "./../../../../media"
@@ -0,0 +1,899 @@
+/** @file
+ A standalone load generator for the Gamecon protocol.
+
+ Connects to a running GameEngineServer and sends the kind of traffic the shooter
+ game does (soldiers, bullets, bricks and barrels moving, footsteps, gunfire and
+ collisions) but with as many objects, connections and events as it's asked for,
+ so the server can be measured and profiled without the game. The objects are
+ created (with the same create messages as the game's) when it connects and
+ destroyed at the end, so the server plays their sounds as it would in the game.
+
+ Every second it logs the messages and bytes sent, how long the socket writes
+ were held up (the server not reading fast enough), the round trip time of a
+ ping over its own ASCII connection (how far behind the server is) and, if
+ vectors are sent as datagrams, how many the server received and discarded.
+
+ It's built as a console application with this file as the only source, linked
+ against the same JUCE library as the app but not FMOD: by the LoadGenerator
+ target in fmod_app/mac_project/shooter.xcodeproj, and by
+ fmod_app/win_project/LoadGenerator.vcxproj, which leaves LoadGenerator.exe
+ next to the app's executable.
+
+ Options (all optional):
+ - @c -host @e name				server address, 127.0.0.1
+ - @c -port @e n				server TCP port, 60000
+ - @c -udp @e n					send vectors as datagrams to this port rather than over TCP
+ - @c -connections @e n			TCP connections the objects are shared between, 1
+ - @c -soldiers @e n, @c -bullets @e n, @c -bricks @e n, @c -barrels @e n
+								the number of each object, 1, 8, 16 and 8
+ - @c -rate @e hz				vector updates per object per second, 60
+ - @c -footsteps @e hz			footsteps per soldier per second, 3
+ - @c -gunfire @e hz			shots per soldier per second, 4
+ - @c -hits @e hz				collisions per bullet, brick and barrel per second, 0.5
+ - @c -ids sequential|unity		object IDs counting up from 1, or scattered negative IDs like Unity's, unity
+ - @c -binary					switch the connections to binary frames
+ - @c -seconds @e n				how long to run, 10
+ - @c -seed @e n				seed for the random events, 1
+ */
+
+#include <juce/juce.h>
+#include "../fmod_app/GameconBinary.h"
+#include "../fmod_app/MessageParser.h"
+#include "../fmod_app/Histogram.h"
+
+#ifdef JUCE_WINDOWS
+#define snprintf _snprintf
+#endif
+
+namespace
+{
+	struct Options
+	{
+		Options()
+		:	host("127.0.0.1"),
+			port(60000),
+			datagramPort(0),
+			numConnections(1),
+			numSoldiers(1),
+			numBullets(8),
+			numBricks(16),
+			numBarrels(8),
+			updateRate(60.0),
+			footstepRate(3.0),
+			gunfireRate(4.0),
+			hitRate(0.5),
+			unityIds(true),
+			binary(false),
+			seconds(10.0),
+			seed(1)
+		{
+		}
+
+		/** @return false if an option wasn't recognised. */
+		bool parse(StringArray const& args)
+		{
+			for(int i = 0; i < args.size(); i++)
+			{
+				const String& arg = args[i];
+				const String value = args[i + 1];
+
+				if(arg == "-binary")		{ binary = true; continue; }
+
+				if(arg == "-host")				host = value;
+				else if(arg == "-port")			port = value.getIntValue();
+				else if(arg == "-udp")			datagramPort = value.getIntValue();
+				else if(arg == "-connections")	numConnections = jmax(1, value.getIntValue());
+				else if(arg == "-soldiers")		numSoldiers = jmax(0, value.getIntValue());
+				else if(arg == "-bullets")		numBullets = jmax(0, value.getIntValue());
+				else if(arg == "-bricks")		numBricks = jmax(0, value.getIntValue());
+				else if(arg == "-barrels")		numBarrels = jmax(0, value.getIntValue());
+				else if(arg == "-rate")			updateRate = jmax(1.0, value.getDoubleValue());
+				else if(arg == "-footsteps")	footstepRate = value.getDoubleValue();
+				else if(arg == "-gunfire")		gunfireRate = value.getDoubleValue();
+				else if(arg == "-hits")			hitRate = value.getDoubleValue();
+				else if(arg == "-ids")			unityIds = value != "sequential";
+				else if(arg == "-seconds")		seconds = value.getDoubleValue();
+				else if(arg == "-seed")			seed = value.getLargeIntValue();
+				else return false;
+
+				i++; // skip the value
+			}
+
+			return true;
+		}
+
+		String host;
+		int port, datagramPort, numConnections;
+		int numSoldiers, numBullets, numBricks, numBarrels;
+		double updateRate, footstepRate, gunfireRate, hitRate;
+		bool unityIds, binary;
+		double seconds;
+		int64 seed;
+	};
+
+	/** The names the shooter game sends. */
+	namespace Names
+	{
+		static const char* const surfaces[] = { "dirt", "wood", "metal", "concrete", "sand", "water", "glass" };
+		static const int numFootstepSurfaces = 5;	// no water or glass
+		static const int numSurfaces = 7;
+	}
+
+	/** One moving object in the game. */
+	struct GameObject
+	{
+		enum Kind { soldier, bullet, brick, barrel };
+
+		Kind kind;
+		int id;
+		int connection;
+		float pos[3], vel[3];
+
+		const char* getName() const
+		{
+			static const char* const names[] = { "soldier", "bullet", "brick", "barrel" };
+			return names[kind];
+		}
+
+		const char* getHitName() const
+		{
+			static const char* const names[] = { "soldier.hit", "bullet.hit", "brick.hit", "barrel.hit" };
+			return names[kind];
+		}
+	};
+
+	static void appendVarint(MemoryOutputStream& out, uint32 value)
+	{
+		while(value >= 0x80)
+		{
+			out.writeByte((char)(value | 0x80));
+			value >>= 7;
+		}
+
+		out.writeByte((char)value);
+	}
+
+	static void appendFloat(MemoryOutputStream& out, float value)
+	{
+		uint32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		for(int i = 0; i < 4; i++)
+			out.writeByte((char)(bits >> (i * 8)));
+	}
+
+	/** A TCP connection sending ASCII lines or binary frames.
+	 Messages are collected and sent with one write per tick. */
+	class Connection
+	{
+	public:
+		Connection()
+		:	binary(false),
+			numMessages(0)
+		{
+		}
+
+		bool connect(Options const& options)
+		{
+			if(!socket.connect(options.host, options.port, 3000))
+				return false;
+
+			if(options.binary)
+				binary = switchToBinary();
+
+			return true;
+		}
+
+		bool isBinary() const { return binary; }
+
+		void sendVector(const char* name, int id, const float* vector)
+		{
+			if(binary)
+			{
+				GameconBinary::Writer frame('v');
+				frame.writeVarint(getNameIndex(name));
+				frame.writeSignedVarint(id);
+				frame.writeFloat(vector[0]);
+				frame.writeFloat(vector[1]);
+				frame.writeFloat(vector[2]);
+				addFrame(frame);
+			}
+			else
+			{
+				addLine("%s V \"%d %g %g %g\"\n", name, id, vector[0], vector[1], vector[2]);
+			}
+		}
+
+		void sendHit(const char* name, int id, const char* otherName, float velocity)
+		{
+			if(binary)
+			{
+				const uint32 otherIndex = getNameIndex(otherName);
+
+				GameconBinary::Writer frame('c');
+				frame.writeVarint(getNameIndex(name));
+				frame.writeSignedVarint(id);
+				frame.writeVarint(otherIndex);
+				frame.writeFloat(velocity);
+				addFrame(frame);
+			}
+			else
+			{
+				addLine("%s C \"%d %s %g\"\n", name, id, otherName, velocity);
+			}
+		}
+
+		/** Sends an int message without an ID, e.g., "brick.create i -1234". */
+		void sendInt(const char* name, int value)
+		{
+			if(binary)
+			{
+				GameconBinary::Writer frame('i');
+				frame.writeVarint(getNameIndex(name));
+				frame.writeSignedVarint(0);
+				frame.writeSignedVarint(value);
+				addFrame(frame);
+			}
+			else
+			{
+				addLine("%s i \"%d\"\n", name, value);
+			}
+		}
+
+		void sendString(const char* name, int id, const char* value)
+		{
+			if(binary)
+			{
+				const int length = (int)strlen(value);
+
+				GameconBinary::Writer frame('s');
+				frame.writeVarint(getNameIndex(name));
+				frame.writeSignedVarint(id);
+				frame.writeVarint(length);
+				frame.writeBytes(value, length);
+				addFrame(frame);
+			}
+			else
+			{
+				addLine("%s S \"%d %s\"\n", name, id, value);
+			}
+		}
+
+		/** Sends everything collected since the last flush.
+		 @return the number of bytes sent, or -1 if the connection failed. */
+		int flush()
+		{
+			const int size = (int)pending.getDataSize();
+
+			if(size > 0 && socket.write(pending.getData(), size) != size)
+				return -1;
+
+			pending.reset();
+			return size;
+		}
+
+		/** The number of messages sent or waiting to be sent, not counting name declarations. */
+		int64 getNumMessages() const { return numMessages; }
+
+	private:
+		StreamingSocket socket;
+		bool binary;
+		StringArray names;		// indexed by binary name index
+		MemoryOutputStream pending;
+		int64 numMessages;
+
+		bool switchToBinary()
+		{
+			const String request(String(GameconBinary::switchMessage) + "\n");
+			socket.write(request.toUTF8(), request.length());
+
+			// the server echoes the line, anything else means it can't do binary frames
+			char echo[64] = { 0 };
+			int length = 0;
+
+			while(length < (int)sizeof(echo) - 1 && socket.waitUntilReady(true, 1000) == 1)
+			{
+				if(socket.read(echo + length, 1, false) != 1)
+					break;
+
+				if(echo[length++] == '\n')
+					return strncmp(echo, request.toUTF8(), request.length()) == 0;
+			}
+
+			Logger::outputDebugString("The server didn't switch to binary frames, sending ASCII");
+			return false;
+		}
+
+		uint32 getNameIndex(const char* name)
+		{
+			const int index = names.indexOf(name);
+
+			if(index >= 0)
+				return (uint32)index;
+
+			names.add(name);
+
+			GameconBinary::Writer frame(GameconBinary::typeName);
+			frame.writeVarint(names.size() - 1);
+			frame.writeBytes(name, (int)strlen(name));
+			pending.write(frame.getFrame(), frame.getFrameSize());
+
+			return (uint32)(names.size() - 1);
+		}
+
+		void addFrame(GameconBinary::Writer& frame)
+		{
+			jassert(!frame.failed());
+			pending.write(frame.getFrame(), frame.getFrameSize());
+			numMessages++;
+		}
+
+		void addLine(const char* format, ...)
+		{
+			char line[256];
+
+			va_list args;
+			va_start(args, format);
+			const int length = vsnprintf(line, sizeof(line), format, args);
+			va_end(args);
+
+			pending.write(line, jlimit(0, (int)sizeof(line) - 1, length));
+			numMessages++;
+		}
+
+		Connection(const Connection&);
+		Connection& operator=(const Connection&);
+	};
+
+	/** Packs vector records into datagrams (see @ref Datagrams). */
+	class DatagramSender
+	{
+	public:
+		/** Kept below a typical MTU so datagrams aren't fragmented. */
+		enum { maxSize = 1400 };
+
+		DatagramSender(int id)
+		:	socket(0),
+			senderId((uint32)id),
+			sequence(0),
+			numRecords(0),
+			numDatagrams(0)
+		{
+		}
+
+		bool connect(Options const& options)
+		{
+			return socket.connect(options.host, options.datagramPort);
+		}
+
+		void sendVector(const char* name, int id, const float* vector)
+		{
+			const int nameLength = (int)strlen(name);
+
+			// a record is at most 5 + name + 5 + 12 bytes
+			if((int)pending.getDataSize() + nameLength + 22 > maxSize)
+				flush();
+
+			if(pending.getDataSize() == 0)
+			{
+				pending.writeByte((char)GameconBinary::datagramMarker);
+				appendVarint(pending, senderId);
+				appendVarint(pending, ++sequence);
+			}
+
+			appendVarint(pending, nameLength);
+			pending.write(name, nameLength);
+			appendVarint(pending, ((uint32)id << 1) ^ (uint32)(id >> 31));
+			appendFloat(pending, vector[0]);
+			appendFloat(pending, vector[1]);
+			appendFloat(pending, vector[2]);
+			numRecords++;
+		}
+
+		void flush()
+		{
+			if(pending.getDataSize() == 0)
+				return;
+
+			socket.write(pending.getData(), (int)pending.getDataSize());
+			pending.reset();
+			numDatagrams++;
+		}
+
+		int64 getNumRecords() const { return numRecords; }
+		int getNumDatagrams() const { return numDatagrams; }
+
+	private:
+		DatagramSocket socket;
+		const uint32 senderId;
+		uint32 sequence;
+		MemoryOutputStream pending;
+		int64 numRecords;
+		int numDatagrams;
+
+		DatagramSender(const DatagramSender&);
+		DatagramSender& operator=(const DatagramSender&);
+	};
+
+	/** Measures the round trip of GameconBinary::pingName messages over an ASCII connection of its own. */
+	class Pinger
+	{
+	public:
+		enum { maxOutstanding = 64 };
+
+		Pinger()
+		:	nextToken(0),
+			serverDatagrams(0),
+			serverStaleDatagrams(0)
+		{
+			zeromem(sendTimes, sizeof(sendTimes));
+		}
+
+		bool connect(Options const& options)
+		{
+			return socket.connect(options.host, options.port, 3000);
+		}
+
+		void ping()
+		{
+			char line[64];
+			const int length = snprintf(line, sizeof(line), "%s s %d\n", GameconBinary::pingName, nextToken);
+
+			sendTimes[nextToken % maxOutstanding] = Time::getHighResolutionTicks();
+			nextToken++;
+			socket.write(line, length);
+		}
+
+		/** Reads any answers which have arrived, without waiting. */
+		void readAnswers()
+		{
+			while(socket.waitUntilReady(true, 0) == 1)
+			{
+				int bufferSize;
+				char* buffer = parser.getWriteBuffer(bufferSize);
+				const int numBytes = socket.read(buffer, bufferSize, false);
+
+				if(numBytes <= 0)
+					return;
+
+				parser.written(numBytes);
+
+				TokenSpan line;
+
+				while(parser.readLine(line))
+					handleAnswer(line);
+			}
+		}
+
+		/** Round trips in microseconds since clearRoundTrips(). */
+		Histogram const& getRoundTrips() const { return roundTrips; }
+
+		/** Round trips in microseconds since connecting. */
+		Histogram const& getAllRoundTrips() const { return allRoundTrips; }
+
+		void clearRoundTrips() { roundTrips.clear(); }
+
+		/** The counts from the latest answer. */
+		int getServerDatagrams() const { return serverDatagrams; }
+		int getServerStaleDatagrams() const { return serverStaleDatagrams; }
+
+	private:
+		StreamingSocket socket;
+		MessageParser parser;
+		int64 sendTimes[maxOutstanding];
+		int nextToken;
+		Histogram roundTrips, allRoundTrips;
+		int serverDatagrams, serverStaleDatagrams;
+
+		void handleAnswer(TokenSpan const& line)
+		{
+			TokenSpan tokens[3], values[3];
+			MessageParser::tokenise(line, tokens, 3);
+
+			if(!tokens[0].equals(GameconBinary::pingName)
+			   || MessageParser::tokenise(tokens[2].unquoted(), values, 3) != 3)
+				return;
+
+			const int token = values[0].getIntValue();
+
+			// answers to pings which have been overwritten are too late to time
+			if(isPositiveAndBelow(nextToken - 1 - token, (int)maxOutstanding))
+			{
+				const int64 elapsed = Time::getHighResolutionTicks() - sendTimes[token % maxOutstanding];
+				roundTrips.add(Histogram::ticksToMicroseconds(elapsed));
+				allRoundTrips.add(Histogram::ticksToMicroseconds(elapsed));
+			}
+
+			serverDatagrams = values[1].getIntValue();
+			serverStaleDatagrams = values[2].getIntValue();
+		}
+
+		Pinger(const Pinger&);
+		Pinger& operator=(const Pinger&);
+	};
+
+	class LoadGenerator
+	{
+	public:
+		LoadGenerator(Options const& generatorOptions)
+		:	options(generatorOptions),
+			random(generatorOptions.seed)
+		{
+			cameraPos[0] = cameraPos[1] = cameraPos[2] = 0.0f;
+		}
+
+		bool connect()
+		{
+			for(int i = 0; i < options.numConnections; i++)
+			{
+				Connection* connection = new Connection();
+				connections.add(connection);
+
+				if(!connection->connect(options))
+				{
+					Logger::outputDebugString("Can't connect to " + options.host + ":" + String(options.port));
+					return false;
+				}
+			}
+
+			if(options.datagramPort > 0)
+			{
+				datagrams = new DatagramSender(random.nextInt(1 << 30));
+
+				if(!datagrams->connect(options))
+				{
+					Logger::outputDebugString("Can't send datagrams to port " + String(options.datagramPort));
+					return false;
+				}
+			}
+
+			if(!pinger.connect(options))
+				return false;
+
+			createObjects(GameObject::soldier, options.numSoldiers);
+			createObjects(GameObject::bullet, options.numBullets);
+			createObjects(GameObject::brick, options.numBricks);
+			createObjects(GameObject::barrel, options.numBarrels);
+
+			// without these the server has no objects for the vectors and collisions to play at
+			return sendCreateOrDestroy("create");
+		}
+
+		void run()
+		{
+			const int64 ticksPerSecond = Time::secondsToHighResolutionTicks(1.0);
+			const int64 period = jmax((int64)1, Time::secondsToHighResolutionTicks(1.0 / options.updateRate));
+			const int64 pingPeriod = ticksPerSecond / 10;
+			const int64 startTime = Time::getHighResolutionTicks();
+			const int64 endTime = startTime + Time::secondsToHighResolutionTicks(options.seconds);
+
+			int64 nextTick = startTime, nextPing = startTime, nextReport = startTime + ticksPerSecond;
+			int64 blockedTicks = 0, numBytes = 0;
+			int numTicks = 0, numLateTicks = 0;
+			Report last;
+
+			for(;;)
+			{
+				const int64 now = Time::getHighResolutionTicks();
+
+				if(now >= endTime)
+					break;
+
+				if(now >= nextTick)
+				{
+					generateTick();
+
+					const int64 flushStart = Time::getHighResolutionTicks();
+
+					for(int i = 0; i < connections.size(); i++)
+					{
+						const int sent = connections.getUnchecked(i)->flush();
+
+						if(sent < 0)
+						{
+							Logger::outputDebugString("The server closed the connection");
+							return;
+						}
+
+						numBytes += sent;
+					}
+
+					if(datagrams != 0)
+						datagrams->flush();
+
+					blockedTicks += Time::getHighResolutionTicks() - flushStart;
+					numTicks++;
+					nextTick += period;
+
+					// don't try to catch up, the report shows the rate which was achieved
+					if(Time::getHighResolutionTicks() >= nextTick)
+					{
+						numLateTicks++;
+						nextTick = Time::getHighResolutionTicks() + period;
+					}
+				}
+
+				if(now >= nextPing)
+				{
+					pinger.ping();
+					nextPing += pingPeriod;
+				}
+
+				pinger.readAnswers();
+
+				if(now >= nextReport)
+				{
+					Report current(*this, now - startTime, numBytes, blockedTicks, numLateTicks);
+					logReport(current, last, pinger.getRoundTrips());
+					pinger.clearRoundTrips();
+					last = current;
+					nextReport += ticksPerSecond;
+				}
+
+				const int64 wake = jmin(nextTick, nextPing, nextReport);
+				const int msToWait = (int)((wake - Time::getHighResolutionTicks()) * 1000 / ticksPerSecond);
+
+				if(msToWait > 0)
+					Thread::sleep(msToWait);
+			}
+
+			const int64 elapsed = Time::getHighResolutionTicks() - startTime;
+
+			sendCreateOrDestroy("destroy");
+
+			// give the last pings a moment to come back
+			Thread::sleep(200);
+			pinger.readAnswers();
+
+			Logger::outputDebugString("Total over " + String(numTicks) + " ticks:");
+
+			const Report total(*this, elapsed, numBytes, blockedTicks, numLateTicks);
+			logReport(total, Report(), pinger.getAllRoundTrips());
+		}
+
+	private:
+		/** Totals at one moment, so the difference between two can be logged. */
+		struct Report
+		{
+			Report()
+			:	time(0), numMessages(0), numBytes(0), numRecords(0),
+				numDatagrams(0), serverDatagrams(0), serverStale(0), blocked(0), numLateTicks(0)
+			{
+			}
+
+			Report(LoadGenerator& generator, int64 elapsed, int64 bytes, int64 blockedTicks, int lateTicks)
+			:	time(elapsed), numMessages(0), numBytes(bytes), numRecords(0), numDatagrams(0),
+				serverDatagrams(generator.pinger.getServerDatagrams()),
+				serverStale(generator.pinger.getServerStaleDatagrams()),
+				blocked(blockedTicks),
+				numLateTicks(lateTicks)
+			{
+				for(int i = 0; i < generator.connections.size(); i++)
+					numMessages += generator.connections.getUnchecked(i)->getNumMessages();
+
+				if(generator.datagrams != 0)
+				{
+					numRecords = generator.datagrams->getNumRecords();
+					numDatagrams = generator.datagrams->getNumDatagrams();
+				}
+			}
+
+			int64 time, numMessages, numBytes, numRecords;
+			int numDatagrams, serverDatagrams, serverStale;
+			int64 blocked;
+			int numLateTicks;
+		};
+
+		Options options;
+		Random random;
+		OwnedArray<Connection> connections;
+		ScopedPointer<DatagramSender> datagrams;
+		Pinger pinger;
+		Array<GameObject> objects;
+		float cameraPos[3];
+
+		void createObjects(GameObject::Kind kind, int count)
+		{
+			for(int i = 0; i < count; i++)
+			{
+				GameObject object;
+				object.kind = kind;
+				object.id = options.unityIds ? getUnityId() : i + 1;
+				object.connection = objects.size() % connections.size();
+
+				for(int axis = 0; axis < 3; axis++)
+				{
+					object.pos[axis] = random.nextFloat() * 100.0f - 50.0f;
+					object.vel[axis] = random.nextFloat() * 2.0f - 1.0f;
+				}
+
+				if(kind == GameObject::bullet)
+					object.vel[2] *= 300.0f;
+
+				objects.add(object);
+			}
+		}
+
+		/** Sends the camera's and each object's create or destroy message, as the game does.
+		 Bullets aren't sent, the server has a single bullet object of its own.
+		 @return false if a connection failed. */
+		bool sendCreateOrDestroy(const char* action)
+		{
+			char name[64];
+
+			snprintf(name, sizeof(name), "camera.%s", action);
+			connections.getUnchecked(0)->sendInt(name, 0);
+
+			for(int i = 0; i < objects.size(); i++)
+			{
+				GameObject const& object = objects.getReference(i);
+
+				if(object.kind == GameObject::bullet)
+					continue;
+
+				snprintf(name, sizeof(name), "%s.%s", object.getName(), action);
+				connections.getUnchecked(object.connection)->sendInt(name, object.id);
+			}
+
+			for(int i = 0; i < connections.size(); i++)
+			{
+				if(connections.getUnchecked(i)->flush() < 0)
+				{
+					Logger::outputDebugString("The server closed the connection");
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		/** Unity's instance IDs are negative and scattered. */
+		int getUnityId()
+		{
+			for(;;)
+			{
+				const int id = -(1000 + random.nextInt(1 << 20));
+				bool used = false;
+
+				for(int i = 0; i < objects.size() && !used; i++)
+					used = objects.getReference(i).id == id;
+
+				if(!used)
+					return id;
+			}
+		}
+
+		/** True on average rate times per second. */
+		bool happens(double rate)
+		{
+			return rate > 0.0 && random.nextDouble() < rate / options.updateRate;
+		}
+
+		void sendVector(GameObject const& object, const char* param, const float* vector)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "%s.%s", object.getName(), param);
+
+			if(datagrams != 0)
+				datagrams->sendVector(name, object.id, vector);
+			else
+				connections.getUnchecked(object.connection)->sendVector(name, object.id, vector);
+		}
+
+		void generateTick()
+		{
+			const float dt = (float)(1.0 / options.updateRate);
+			static const float forward[3] = { 0.0f, 0.0f, 1.0f };
+			static const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+			// the camera follows the first soldier
+			if(objects.size() > 0)
+				memcpy(cameraPos, objects.getReference(0).pos, sizeof(cameraPos));
+
+			Connection& first = *connections.getUnchecked(0);
+			first.sendVector("camera.pos", 0, cameraPos);
+			first.sendVector("camera.dir", 0, forward);
+			first.sendVector("camera.up", 0, up);
+
+			for(int i = 0; i < objects.size(); i++)
+			{
+				GameObject& object = objects.getReference(i);
+				Connection& connection = *connections.getUnchecked(object.connection);
+				const char* hitName = object.getHitName();
+
+				for(int axis = 0; axis < 3; axis++)
+					object.pos[axis] += object.vel[axis] * dt;
+
+				sendVector(object, "pos", object.pos);
+
+				switch(object.kind)
+				{
+					case GameObject::soldier:
+						sendVector(object, "vel", object.vel);
+						sendVector(object, "dir", forward);
+
+						if(happens(options.footstepRate))
+							connection.sendHit(hitName, object.id, Names::surfaces[random.nextInt(Names::numFootstepSurfaces)],
+											   random.nextBool() ? 0.4f : 1.0f);
+
+						if(happens(options.gunfireRate))
+							connection.sendString("soldier.gun", object.id, "fire");
+						break;
+
+					case GameObject::bullet:
+						if(happens(options.hitRate))
+						{
+							connection.sendHit(hitName, object.id, Names::surfaces[random.nextInt(Names::numSurfaces)],
+											   0.8f + random.nextFloat() * 0.2f);
+							object.pos[2] = 0.0f;	// the next bullet starts again from the gun
+						}
+						break;
+
+					default:
+						sendVector(object, "vel", object.vel);
+
+						if(happens(options.hitRate))
+							connection.sendHit(hitName, object.id, Names::surfaces[random.nextInt(Names::numFootstepSurfaces)],
+											   random.nextFloat());
+						break;
+				}
+			}
+		}
+
+		void logReport(Report const& current, Report const& last, Histogram const& roundTrips)
+		{
+			const double seconds = jmax(0.001, Time::highResolutionTicksToSeconds(current.time - last.time));
+			const int64 numMessages = (current.numMessages - last.numMessages) + (current.numRecords - last.numRecords);
+			const int numDatagrams = current.numDatagrams - last.numDatagrams;
+			const int serverDatagrams = current.serverDatagrams - last.serverDatagrams;
+
+			String report;
+			report << String(Time::highResolutionTicksToSeconds(current.time), 1) << "s: "
+				   << String((int64)(numMessages / seconds)) << " msg/s, "
+				   << String((current.numBytes - last.numBytes) / (seconds * 1048576.0), 2) << " MB/s TCP, blocked "
+				   << String(Time::highResolutionTicksToSeconds(current.blocked - last.blocked) * 1000.0, 1) << "ms, late ticks "
+				   << String(current.numLateTicks - last.numLateTicks);
+
+			if(datagrams != 0)
+			{
+				report << ", datagrams sent " << String(numDatagrams)
+					   << " received " << String(serverDatagrams)
+					   << " stale " << String(current.serverStale - last.serverStale);
+			}
+
+			report << ", round trip(us) " << roundTrips.getSummary();
+			Logger::outputDebugString(report);
+		}
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	initialiseJuce_NonGUI();
+
+	StringArray args;
+
+	for(int i = 1; i < argc; i++)
+		args.add(argv[i]);
+
+	Options options;
+	int result = 0;
+
+	if(!options.parse(args))
+	{
+		Logger::outputDebugString("Unknown option, see the comment at the top of LoadGenerator.cpp");
+		result = 1;
+	}
+	else
+	{
+		LoadGenerator generator(options);
+
+		if(generator.connect())
+			generator.run();
+		else
+			result = 1;
+	}
+
+	shutdownJuce_NonGUI();
+	return result;
+}
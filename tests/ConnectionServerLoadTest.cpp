@@ -0,0 +1,320 @@
+/** @file
+ A standalone load test of ConnectionServer with many clients at once.
+
+ Starts a ConnectionServer on a loopback port and connects as many clients to
+ it as it allows, 64 by default, which then all stream ASCII vector messages at
+ once in writes of random sizes taken in turn, so lines are split between reads
+ and the network thread has many sockets ready together. Every client must be
+ given its own ID, every vector must arrive whole, once and in order, under the
+ ID of the client which sent it, and every client must be seen to close. One
+ client more than the maximum must be turned away.
+
+ It isn't part of the app project. Build it as a console application with this
+ file, fmod_app/ConnectionServer.cpp and fmod_app/SocketPoller.cpp as its
+ sources, linked against the same JUCE library as the app. It exits with 1 if
+ anything failed.
+
+ Options (all optional):
+ - @c -port @e n				the port to listen on, 60100
+ - @c -connections @e n			the clients, and the server's maximum, 64
+ - @c -vectors @e n				vectors sent by each client, 2000
+ - @c -seed @e n				seed for the write sizes, 1
+ */
+
+#include <juce/juce.h>
+#include "../fmod_app/ConnectionServer.h"
+
+namespace
+{
+	/** How long to wait for the server to catch up before giving up. */
+	static const int timeoutMs = 10000;
+
+	Atomic<int> numFailures;
+
+	void fail(String const& message)
+	{
+		if(++numFailures <= 20)
+			Logger::outputDebugString("FAILED: " + message);
+	}
+
+	/** The name a client sends its vectors under. */
+	String getVectorName(int sender)
+	{
+		return "client" + String(sender) + ".pos";
+	}
+
+	/** Keeps what arrived from each client ID. */
+	class TestServer : public ConnectionServer
+	{
+	public:
+		TestServer(int port, int maxClients)
+		:	ConnectionServer(port, maxClients)
+		{
+			clientStates.insertMultiple(0, ClientState(), maxClients + 1);
+		}
+
+		~TestServer()
+		{
+			// the network thread calls this class, so it has to stop before this goes
+			stopThread(4000);
+		}
+
+		Atomic<int> numOpened, numClosed, numVectors;
+
+		/** The state of a client ID, only read once the network thread is quiet. */
+		struct ClientState
+		{
+			ClientState() : open(false), sender(-1), numVectors(0) {}
+
+			bool open;
+			int sender;			// the client which sent the vectors, or -1 before the first
+			int numVectors;		// also the sequence number the next vector should have
+		};
+
+		ClientState getClientState(int clientId) const
+		{
+			const ScopedLock sl(lock);
+			return clientStates[clientId];
+		}
+
+		void handleConnectionOpened(int clientId)
+		{
+			const ScopedLock sl(lock);
+
+			if(!isPositiveAndBelow(clientId - 1, getMaxClients()))
+			{
+				fail("a client was given ID " + String(clientId));
+				return;
+			}
+
+			ClientState& state = clientStates.getReference(clientId);
+
+			if(state.open)
+				fail("ID " + String(clientId) + " was given to a second client while the first was connected");
+
+			state = ClientState();
+			state.open = true;
+			++numOpened;
+		}
+
+		void handleConnectionClosed(int clientId)
+		{
+			const ScopedLock sl(lock);
+
+			if(!isPositiveAndBelow(clientId - 1, getMaxClients()) || !clientStates[clientId].open)
+				fail("ID " + String(clientId) + " closed without being opened");
+			else
+				clientStates.getReference(clientId).open = false;
+
+			++numClosed;
+		}
+
+		void handleConnectionMessage(int clientId, TokenSpan const& name, TokenSpan const& type, TokenSpan const& message)
+		{
+			// e.g., client7.pos v "7 1234 1.5 -2.25", the sender and the sequence number then the rest of the vector
+			TokenSpan items[4];
+			const int numItems = MessageParser::tokenise(message.unquoted(), items, numElementsInArray(items));
+			const int sender = items[0].getIntValue();
+
+			const ScopedLock sl(lock);
+			ClientState& state = clientStates.getReference(clientId);
+
+			if(!state.open)
+			{
+				fail("a message arrived from ID " + String(clientId) + " which isn't connected");
+				return;
+			}
+
+			if(!type.equals("v") || numItems != 4 || !name.equals(getVectorName(sender).toUTF8())
+			   || items[2].getDoubleValue() != 1.5 || items[3].getDoubleValue() != -2.25)
+			{
+				fail("ID " + String(clientId) + " received '" + name.toString() + " " + type.toString() + " " + message.toString() + "'");
+				return;
+			}
+
+			if(state.sender < 0)
+				state.sender = sender;
+			else if(state.sender != sender)
+				fail("ID " + String(clientId) + " received vectors from client " + String(state.sender) + " and client " + String(sender));
+
+			if(items[1].getIntValue() != state.numVectors)
+				fail("client " + String(sender) + "'s vector " + String(state.numVectors) + " arrived as " + items[1].toString());
+
+			state.numVectors++;
+			++numVectors;
+		}
+
+		void handleConnectionFrame(int clientId, const uint8* /*body*/, int /*size*/)
+		{
+			fail("ID " + String(clientId) + " received a binary frame");
+		}
+
+		void handleConnectionDatagram(const uint8* /*body*/, int /*size*/)
+		{
+			fail("a datagram arrived");
+		}
+
+	private:
+		CriticalSection lock;
+		Array<ClientState> clientStates;		// by client ID, 0 isn't used
+
+		TestServer(const TestServer&);
+		TestServer& operator=(const TestServer&);
+	};
+
+	/** Waits for a count kept by the network thread to reach a target.
+	 @return false if it didn't in time. */
+	bool waitFor(Atomic<int> const& count, int target)
+	{
+		const uint32 start = Time::getMillisecondCounter();
+
+		while(count.get() < target)
+		{
+			if(Time::getMillisecondCounter() - start > (uint32)timeoutMs)
+				return false;
+
+			Thread::sleep(5);
+		}
+
+		return true;
+	}
+
+	/** One client's connection and the part of its stream not sent yet. */
+	struct Sender
+	{
+		StreamingSocket socket;
+		MemoryBlock stream;
+		int numSent;
+	};
+
+	void test(Random& random, int port, int numConnections, int numVectors)
+	{
+		TestServer server(port, numConnections);
+		OwnedArray<Sender> senders;
+
+		for(int i = 0; i < numConnections; i++)
+		{
+			Sender* sender = new Sender();
+			senders.add(sender);
+			sender->numSent = 0;
+
+			if(!sender->socket.connect("127.0.0.1", port, 3000))
+			{
+				fail("client " + String(i) + " couldn't connect to port " + String(port));
+				return;
+			}
+
+			for(int v = 0; v < numVectors; v++)
+			{
+				const String line(getVectorName(i) + " v \"" + String(i) + " " + String(v) + " 1.5 -2.25\"\n");
+				sender->stream.append(line.toUTF8(), strlen(line.toUTF8()));
+			}
+		}
+
+		if(!waitFor(server.numOpened, numConnections))
+			fail(String(server.numOpened.get()) + " of the " + String(numConnections) + " clients were opened");
+
+		// one more than the maximum is turned away
+		StreamingSocket extra;
+		char byte;
+
+		if(extra.connect("127.0.0.1", port, 3000)
+		   && !(extra.waitUntilReady(true, timeoutMs) == 1 && extra.read(&byte, 1, false) <= 0))
+			fail("a client over the maximum wasn't closed");
+
+		extra.close();
+
+		// every client writes a little in turn until they've all sent everything
+		for(int numFinished = 0; numFinished < numConnections;)
+		{
+			numFinished = 0;
+
+			for(int i = 0; i < numConnections; i++)
+			{
+				Sender& sender = *senders.getUnchecked(i);
+				const int remaining = (int)sender.stream.getSize() - sender.numSent;
+
+				if(remaining == 0)
+				{
+					numFinished++;
+					continue;
+				}
+
+				const int numBytes = jmin(remaining, 1 + random.nextInt(random.nextInt(8) == 0 ? 4096 : 256));
+
+				if(sender.socket.write((const char*)sender.stream.getData() + sender.numSent, numBytes) != numBytes)
+				{
+					fail("client " + String(i) + "'s write failed");
+					return;
+				}
+
+				sender.numSent += numBytes;
+			}
+		}
+
+		if(!waitFor(server.numVectors, numConnections * numVectors))
+			fail(String(server.numVectors.get()) + " of the " + String(numConnections * numVectors) + " vectors arrived");
+
+		// each client's vectors all came under its own ID
+		Array<int> idsBySender;
+		idsBySender.insertMultiple(0, 0, numConnections);
+
+		for(int clientId = 1; clientId <= numConnections; clientId++)
+		{
+			const TestServer::ClientState state(server.getClientState(clientId));
+
+			if(!state.open)
+			{
+				fail("ID " + String(clientId) + " isn't connected");
+				continue;
+			}
+
+			if(!isPositiveAndBelow(state.sender, numConnections))
+			{
+				fail("ID " + String(clientId) + " received no vectors");
+				continue;
+			}
+
+			if(idsBySender[state.sender] != 0)
+				fail("client " + String(state.sender) + " was seen under IDs " + String(idsBySender[state.sender]) + " and " + String(clientId));
+
+			idsBySender.set(state.sender, clientId);
+
+			if(state.numVectors != numVectors)
+				fail("ID " + String(clientId) + " received " + String(state.numVectors) + " of client " + String(state.sender) + "'s " + String(numVectors) + " vectors");
+		}
+
+		senders.clear();
+
+		if(!waitFor(server.numClosed, numConnections))
+			fail(String(server.numClosed.get()) + " of the " + String(numConnections) + " clients were closed");
+
+		Logger::outputDebugString(String(numConnections) + " clients, " + String(server.numVectors.get()) + " vectors received");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	initialiseJuce_NonGUI();
+
+	int64 seed = 1;
+	int port = 60100, numConnections = 64, numVectors = 2000;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		const String arg(argv[i]), value(argv[i + 1]);
+
+		if(arg == "-port")					port = value.getIntValue();
+		else if(arg == "-connections")		numConnections = jmax(1, value.getIntValue());
+		else if(arg == "-vectors")			numVectors = jmax(1, value.getIntValue());
+		else if(arg == "-seed")				seed = value.getLargeIntValue();
+	}
+
+	Random random(seed);
+	test(random, port, numConnections, numVectors);
+
+	Logger::outputDebugString(numFailures.get() == 0 ? "passed" : String(numFailures.get()) + " failures");
+
+	shutdownJuce_NonGUI();
+	return numFailures.get() == 0 ? 0 : 1;
+}
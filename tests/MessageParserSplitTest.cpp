@@ -0,0 +1,410 @@
+/** @file
+ A standalone regression test for MessageParser with messages split across reads.
+
+ Builds a stream of Gamecon style lines (including quoted tokens with spaces
+ in them, tabs, CRLF endings, empty lines and lines too long for the buffer)
+ and feeds it to a small MessageParser in reads of random sizes, the same way
+ ConnectionServer does, so lines are split at every possible point and wrap
+ around the end of the ring. Every line which fits must come out whole and
+ tokenise back to the tokens it was made from; no part of a line which doesn't
+ fit may come out, and the lines after it must be unharmed. A few fixed cases
+ check over-long lines and the wrap-around of readLine() and peek() directly.
+
+ It isn't part of the app project. Build it as a console application with this
+ file as the only source, linked against the same JUCE library as the app.
+ It exits with 1 if anything failed.
+
+ Options (all optional):
+ - @c -seed @e n				seed for the random streams, 1
+ - @c -streams @e n				the number of random streams, 200
+ - @c -lines @e n				lines per stream, 500
+ */
+
+#include <juce/juce.h>
+#include "../fmod_app/MessageParser.h"
+
+namespace
+{
+	/** Small, so lines wrap around the ring often and some don't fit at all. */
+	static const int bufferSize = 256;
+
+	int numFailures = 0;
+
+	void fail(String const& message)
+	{
+		if(numFailures++ < 20)
+			Logger::outputDebugString("FAILED: " + message);
+	}
+
+	/** A line of the stream and the tokens it should split into. */
+	struct Line
+	{
+		String text;				// without its line ending
+		StringArray tokens;
+		bool tooLong;				// won't fit in the parser's buffer with its line ending
+	};
+
+	String makeWord(Random& random, int maxLength)
+	{
+		static const char characters[] = "abcdefghijklmnopqrstuvwxyz0123456789.-_";
+		const int length = 1 + random.nextInt(maxLength);
+		String word;
+
+		for(int i = 0; i < length; i++)
+			word += String::charToString((juce_wchar)characters[random.nextInt(numElementsInArray(characters) - 1)]);
+
+		return word;
+	}
+
+	/** A quoted token, sometimes with spaces (and the other kind of quote) inside. */
+	String makeQuoted(Random& random)
+	{
+		const char quote = random.nextBool() ? '"' : '\'';
+		const char other = quote == '"' ? '\'' : '"';
+		String token = String::charToString((juce_wchar)quote);
+		const int numWords = 1 + random.nextInt(4);
+
+		for(int i = 0; i < numWords; i++)
+		{
+			if(i > 0)
+				token += random.nextInt(3) == 0 ? String::charToString((juce_wchar)other) : String(" ");
+
+			token += makeWord(random, 8);
+		}
+
+		return token + String::charToString((juce_wchar)quote);
+	}
+
+	Line makeLine(Random& random)
+	{
+		Line line;
+
+		const int kind = random.nextInt(20);
+
+		if(kind == 0)
+		{
+			// empty, or only whitespace
+			line.text = random.nextBool() ? String::empty : String(" \t ");
+		}
+		else
+		{
+			// e.g., brick.pos V "-1234 1.5 0 -2", or something far too long
+			const int numTokens = kind == 1 ? 40 + random.nextInt(40) : 1 + random.nextInt(6);
+
+			for(int i = 0; i < numTokens; i++)
+				line.tokens.add(random.nextInt(3) == 0 ? makeQuoted(random) : makeWord(random, 12));
+
+			for(int i = 0; i < numTokens; i++)
+			{
+				if(i > 0 || random.nextInt(4) == 0)
+					line.text += random.nextInt(4) == 0 ? "\t" : (random.nextInt(4) == 0 ? "  " : " ");
+
+				line.text += line.tokens[i];
+			}
+		}
+
+		return line;
+	}
+
+	void checkLine(TokenSpan const& parsed, Line const& expected)
+	{
+		const String text(parsed.toString());
+
+		if(text != expected.text)
+		{
+			fail("expected '" + expected.text + "' but parsed '" + text + "'");
+			return;
+		}
+
+		TokenSpan tokens[128];
+		const int numTokens = MessageParser::tokenise(parsed, tokens, numElementsInArray(tokens));
+
+		if(numTokens != expected.tokens.size())
+		{
+			fail("'" + text + "' has " + String(expected.tokens.size()) + " tokens but tokenised into " + String(numTokens));
+			return;
+		}
+
+		for(int i = 0; i < numTokens; i++)
+		{
+			if(tokens[i].toString() != expected.tokens[i])
+				fail("token " + String(i) + " of '" + text + "' is '" + tokens[i].toString() + "'");
+		}
+	}
+
+	/** Feeds one random stream through a parser.
+	 @return the number of lines checked. */
+	int testStream(Random& random, int numLines)
+	{
+		Array<Line> lines;
+		MemoryBlock stream;
+
+		for(int i = 0; i < numLines; i++)
+		{
+			Line line = makeLine(random);
+			const String ending(random.nextInt(4) == 0 ? "\r\n" : "\n");
+			const int size = (int)strlen(line.text.toUTF8()) + (int)strlen(ending.toUTF8());
+
+			line.tooLong = size > bufferSize;
+			lines.add(line);
+
+			const String withEnding(line.text + ending);
+			stream.append(withEnding.toUTF8(), (size_t)size);
+		}
+
+		MessageParser parser(bufferSize);
+		const char* data = (const char*)stream.getData();
+		int remaining = (int)stream.getSize();
+		int next = 0;		// the next expected line
+		int numChecked = 0;
+
+		while(remaining > 0)
+		{
+			// as ConnectionServer does when a line doesn't fit
+			if(parser.isFull())
+				parser.skipLine();
+
+			int numBytesFree;
+			char* buffer = parser.getWriteBuffer(numBytesFree);
+
+			// reads of every size from a single byte to the whole free space
+			const int maxRead = random.nextInt(4) == 0 ? numBytesFree : jmin(numBytesFree, 1 + random.nextInt(16));
+			const int numBytes = jmin(remaining, 1 + random.nextInt(jmax(1, maxRead)));
+
+			memcpy(buffer, data, (size_t)numBytes);
+			parser.written(numBytes);
+			data += numBytes;
+			remaining -= numBytes;
+
+			TokenSpan parsed;
+
+			while(parser.readLine(parsed))
+			{
+				// nothing of a line which didn't fit comes out, the next line is the one after it
+				while(next < lines.size() && lines.getReference(next).tooLong)
+					next++;
+
+				if(next >= lines.size())
+				{
+					fail("parsed more lines than were sent: '" + parsed.toString() + "'");
+					return numChecked;
+				}
+
+				checkLine(parsed, lines.getReference(next++));
+				numChecked++;
+			}
+		}
+
+		while(next < lines.size() && lines.getReference(next).tooLong)
+			next++;
+
+		if(next != lines.size())
+			fail(String(lines.size() - next) + " lines never came out");
+
+		if(parser.getNumBytesReady() != 0)
+			fail(String(parser.getNumBytesReady()) + " bytes left in the parser");
+
+		return numChecked;
+	}
+
+	void write(MessageParser& parser, const char* text)
+	{
+		int length = (int)strlen(text);
+
+		while(length > 0)
+		{
+			int numBytesFree;
+			char* buffer = parser.getWriteBuffer(numBytesFree);
+			const int numBytes = jmin(length, numBytesFree);
+
+			if(numBytes == 0)
+			{
+				fail("no room to write '" + String(text) + "'");
+				return;
+			}
+
+			memcpy(buffer, text, (size_t)numBytes);
+			parser.written(numBytes);
+			text += numBytes;
+			length -= numBytes;
+		}
+	}
+
+	void expectLine(MessageParser& parser, const char* expected)
+	{
+		TokenSpan line;
+
+		if(!parser.readLine(line))
+			fail("no line where '" + String(expected) + "' was expected");
+		else if(!line.equals(expected))
+			fail("expected '" + String(expected) + "' but parsed '" + line.toString() + "'");
+	}
+
+	/** A line too long for the buffer, arriving in pieces, is dropped whole. */
+	void testOverLongLine()
+	{
+		MessageParser parser(bufferSize);
+		TokenSpan line;
+
+		write(parser, "before.line s ok\n");
+		expectLine(parser, "before.line s ok");
+
+		// a little over three buffers' worth, with no line ending until the end
+		String piece("brick.pos V \"12 1.5 0 -2.25\" ");
+		int numWritten = 0;
+
+		while(numWritten < bufferSize * 3)
+		{
+			const char* text = piece.toUTF8();
+			int length = piece.length();
+
+			// as ConnectionServer does, skipping when the buffer fills
+			while(length > 0)
+			{
+				if(parser.isFull())
+					parser.skipLine();
+
+				int numBytesFree;
+				char* buffer = parser.getWriteBuffer(numBytesFree);
+				const int numBytes = jmin(length, numBytesFree);
+
+				memcpy(buffer, text, (size_t)numBytes);
+				parser.written(numBytes);
+				text += numBytes;
+				length -= numBytes;
+				numWritten += numBytes;
+
+				if(parser.readLine(line))
+					fail("part of an over-long line came out as '" + line.toString() + "'");
+			}
+		}
+
+		write(parser, "the end of it\r\nafter.line s ok\n");
+		expectLine(parser, "after.line s ok");
+
+		if(parser.readLine(line) || parser.getNumBytesReady() != 0)
+			fail("bytes left over after the over-long line");
+
+		// reset() for a new connection doesn't skip its first line
+		parser.skipLine();
+		parser.reset();
+		write(parser, "first.line s ok\n");
+		expectLine(parser, "first.line s ok");
+	}
+
+	/** Lines and frames which straddle the end of the ring. */
+	void testWrapAround()
+	{
+		MessageParser parser(bufferSize);
+
+		// fill most of the ring, then take it out so the next line starts near the end
+		String filler;
+
+		while(filler.length() < bufferSize - 20)
+			filler += "x";
+
+		write(parser, (filler + "\n").toUTF8());
+		expectLine(parser, filler.toUTF8());
+
+		// half of this has to go at the start of the ring
+		write(parser, "soldier.pos V \"12 1.5 ");
+
+		TokenSpan line;
+
+		if(parser.readLine(line))
+			fail("a line came out before its line ending arrived");
+
+		write(parser, "0 -2.25\"\r\nbullet.hit C \"3 'wood' 0.9\"\n");
+		expectLine(parser, "soldier.pos V \"12 1.5 0 -2.25\"");
+		expectLine(parser, "bullet.hit C \"3 'wood' 0.9\"");
+
+		if(parser.readLine(line) || parser.getNumBytesReady() != 0)
+			fail("bytes left over after the wrapped lines");
+
+		// a binary frame which wraps is joined by peek()
+		write(parser, (filler.substring(0, bufferSize - 40) + "\n").toUTF8());
+		expectLine(parser, filler.substring(0, bufferSize - 40).toUTF8());
+
+		const char frame[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+		write(parser, frame);
+
+		const int frameSize = (int)strlen(frame);
+		const char* peeked = parser.peek(frameSize);
+
+		if(peeked == 0 || memcmp(peeked, frame, (size_t)frameSize) != 0)
+			fail("a frame which wraps around the ring wasn't joined");
+
+		if(parser.peek(frameSize + 1) != 0)
+			fail("peek() returned more bytes than have arrived");
+
+		parser.consume(frameSize);
+
+		if(parser.getNumBytesReady() != 0)
+			fail("bytes left over after the wrapped frame");
+	}
+
+	/** A quoted token keeps its whitespace and its quotes. */
+	void testTokenise()
+	{
+		const char* text = "  soldier.gun\tS \"7 'grenade launcher'\"  'a \"b\" c' end ";
+		const char* const expected[] = { "soldier.gun", "S", "\"7 'grenade launcher'\"", "'a \"b\" c'", "end" };
+
+		TokenSpan tokens[3];
+		const int numTokens = MessageParser::tokenise(TokenSpan(text, (int)strlen(text)), tokens, numElementsInArray(tokens));
+
+		if(numTokens != numElementsInArray(expected))
+			fail("tokenise() counted " + String(numTokens) + " tokens rather than " + String(numElementsInArray(expected)));
+
+		for(int i = 0; i < numElementsInArray(tokens); i++)
+		{
+			if(!tokens[i].equals(expected[i]))
+				fail("token " + String(i) + " is '" + tokens[i].toString() + "'");
+		}
+
+		TokenSpan values[4];
+		const TokenSpan quoted(tokens[2].unquoted());
+
+		if(MessageParser::tokenise(quoted, values, numElementsInArray(values)) != 2 || values[0].getIntValue() != 7
+		   || !values[1].equals("'grenade launcher'"))
+			fail("the unquoted value '" + quoted.toString() + "' tokenised wrongly");
+
+		// the items a message is missing are empty spans with no text
+		const TokenSpan missing(values[3]);
+
+		if(!missing.equals("") || missing.equals("x") || missing.getIntValue() != 0 || missing.getDoubleValue() != 0)
+			fail("an empty span isn't empty");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	initialiseJuce_NonGUI();
+
+	int64 seed = 1;
+	int numStreams = 200, numLines = 500;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		const String arg(argv[i]), value(argv[i + 1]);
+
+		if(arg == "-seed")			seed = value.getLargeIntValue();
+		else if(arg == "-streams")	numStreams = jmax(1, value.getIntValue());
+		else if(arg == "-lines")	numLines = jmax(1, value.getIntValue());
+	}
+
+	testTokenise();
+	testOverLongLine();
+	testWrapAround();
+
+	Random random(seed);
+	int numChecked = 0;
+
+	for(int i = 0; i < numStreams; i++)
+		numChecked += testStream(random, numLines);
+
+	Logger::outputDebugString(String(numChecked) + " lines in " + String(numStreams) + " streams, "
+							  + (numFailures == 0 ? String("passed") : String(numFailures) + " failures"));
+
+	shutdownJuce_NonGUI();
+	return numFailures == 0 ? 0 : 1;
+}